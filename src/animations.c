@@ -4,6 +4,9 @@
 #include "dragonfail.h"
 #include "dragonfail_error.h"
 #include "draw.h"
+#include "governor.h"
+#include "pressure.h"
+#include "render.h"
 #include "stdio.h"
 #include "termbox2.h"
 #include "utils.h"
@@ -11,114 +14,332 @@
 #include "animations/blizzard.h"
 #include "animations/doom.h"
 #include "animations/matrix.h"
+#include "animations/utils/rng.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+// longest step an animation is advanced by at once, after a stall it picks
+// up where it stopped instead of jumping ahead; it grows with the stretch
+// of a busy system so the animation keeps its pace
+#define ANIMATION_MAX_DT 100
+
 struct animation {
 	void *(*const init)(struct term_buf *buf);
 	void (*const free)(void *state);
-	void (*const draw)(void *state, struct term_buf *buf);
+	// cells hidden by `occ` may be left untouched, the cells written are
+	// added to the row spans of `buf->canvas_damage`; `now` is the
+	// monotonic time in milliseconds and `dt` the time since the previous
+	// call, the animations move by these and not by the number of calls;
+	// returns false when nothing changed
+	bool (*const draw)(void *state, struct term_buf *buf,
+	                   const struct occlusion *occ, uint64_t now, uint32_t dt);
+	// milliseconds between two steps of the animation, it is not drawn more
+	// often than that
+	const uint16_t tick;
 };
 
-static struct random_state *random_init(struct term_buf *buf);
-static void random_free(struct random_state *state);
-static void random_draw(struct random_state *state, struct term_buf *term_buf);
-
+// the animation 0 is one of the others picked at random when lye starts,
+// and it stays the same through resizes and resolution changes
 static const struct animation ANIMATIONS[] = {
-	{
-		// Cast `random_state *` to `void *`
-		.init = (void *(*)(struct term_buf *buf))random_init,
-		.free = (void (*)(void *state))random_free,
-		.draw = (void (*)(void *state, struct term_buf *buf))random_draw,
-	},
-	{
+	[1] = {
 		// Cast `doom_state *` to `void *`
 		.init = (void *(*)(struct term_buf *buf))doom_init,
 		.free = (void (*)(void *state))doom_free,
-		.draw = (void (*)(void *state, struct term_buf *buf))doom,
+		.draw = (bool (*)(void *state, struct term_buf *buf,
+		                  const struct occlusion *occ, uint64_t now,
+		                  uint32_t dt))doom,
+		.tick = DOOM_STEP_MS,
 	},
 	{
 		// Cast `matrix_state *` to `void *`
 		.init = (void *(*)(struct term_buf *buf))matrix_init,
 		.free = (void (*)(void *state))matrix_free,
-		.draw = (void (*)(void *state, struct term_buf *buf))matrix,
+		.draw = (bool (*)(void *state, struct term_buf *buf,
+		                  const struct occlusion *occ, uint64_t now,
+		                  uint32_t dt))matrix,
+		.tick = MATRIX_TICK_MS,
 	},
 	{
 		.init = blizzard_init,
 		.free = blizzard_free,
 		.draw = blizzard_draw,
+		.tick = BLIZZARD_TICK_MS,
 	},
 };
 
 // Generic public facing functions //
 
-void animate(struct term_buf *buf) {
-	if(config.animation >= ARRAY_LENGTH(ANIMATIONS)) {
-		return;
+// only the cells of the upper layers which cover every cell of a scaled
+// cell hide it
+static void occlusion_scale(const struct occlusion *occ,
+                            struct occlusion *scaled, uint8_t sx, uint8_t sy) {
+	scaled->len = 0;
+
+	for(uint8_t i = 0; i < occ->len; ++i) {
+		const struct rect *r = &occ->rects[i];
+		uint16_t x = (r->x + sx - 1) / sx;
+		uint16_t y = (r->y + sy - 1) / sy;
+		uint16_t x2 = (r->x + r->w) / sx;
+		uint16_t y2 = (r->y + r->h) / sy;
+
+		if(x2 > x && y2 > y) {
+			scaled->rects[scaled->len++] = (struct rect){x, y, x2 - x, y2 - y};
+		}
 	}
+}
+
+// every changed cell of the view fills sx by sy cells of the canvas
+static void animation_upscale(struct term_buf *view, struct term_buf *buf,
+                              uint8_t sx, uint8_t sy) {
+	for(uint16_t vy = 0; vy < view->height; ++vy) {
+		struct span *span = &view->canvas_damage[vy];
+		const struct tb_cell *src = view->canvas + (size_t)vy * view->width;
+		uint32_t x = (uint32_t)span->x * sx;
+		uint32_t end = (uint32_t)span->end * sx;
+		uint32_t y_end = (uint32_t)(vy + 1) * sy;
+
+		if(span->end <= span->x) {
+			continue;
+		}
 
-	buf->width = tb_width();
-	buf->height = tb_height();
-	const struct animation *const animation = &ANIMATIONS[config.animation];
+		end = end < buf->width ? end : buf->width;
+		y_end = y_end < buf->height ? y_end : buf->height;
+		*span = (struct span){0};
 
-	if((buf->width != buf->init_width) || (buf->height != buf->init_height)) {
-		animation->free(buf->animation_state);
+		for(uint32_t y = (uint32_t)vy * sy; y < y_end && x < end; ++y) {
+			struct tb_cell *dst = buf->canvas + (size_t)y * buf->width;
+
+			for(uint32_t i = x; i < end; ++i) {
+				dst[i] = src[i / sx];
+			}
+
+			span_add(&buf->canvas_damage[y], x, end);
+		}
+	}
+}
+
+// creates the animation state for the size of the terminal and the level of
+// the governor, below full resolution the animation gets the view instead
+static void animation_build(struct term_buf *buf) // throws
+{
+	const struct animation *const animation = &ANIMATIONS[buf->animation];
+	struct governor *gov = &buf->governor;
+	struct term_buf *view = gov->view;
+	uint8_t sx = governor_scale_x(gov);
+	uint8_t sy = governor_scale_y(gov);
+
+	free(view->canvas);
+	free(view->canvas_damage);
+	view->canvas = NULL;
+	view->canvas_damage = NULL;
+
+	if(sx == 1 && sy == 1) {
 		buf->animation_state = animation->init(buf);
+		return;
 	}
 
-	buf->init_height = buf->height;
-	buf->init_width = buf->width;
+	view->width = (buf->width + sx - 1) / sx;
+	view->height = (buf->height + sy - 1) / sy;
+
+	size_t len = (size_t)view->width * view->height;
+
+	// without its canvas the view has no animation, which draws nothing
+	buf->animation_state = NULL;
+
+	if(len == 0) {
+		return;
+	}
+
+	size_t rows = view->height * sizeof(*view->canvas_damage);
+	view->canvas = malloc_or_throw(len * sizeof(*view->canvas));
+
+	if(view->canvas == NULL) {
+		return;
+	}
+
+	view->canvas_damage = malloc_or_throw(rows);
+
+	if(view->canvas_damage == NULL) {
+		free(view->canvas);
+		view->canvas = NULL;
+		return;
+	}
+
+	memset(view->canvas, 0, len * sizeof(*view->canvas));
+	memset(view->canvas_damage, 0, rows);
+	buf->animation_state = animation->init(view);
+}
+
+// the state is missing when the view could not be allocated
+static void animation_drop(struct term_buf *buf) {
+	if(buf->animation_state != NULL) {
+		ANIMATIONS[buf->animation].free(buf->animation_state);
+	}
+
+	buf->animation_state = NULL;
+}
+
+// draws one frame into the canvas, on the render thread when it runs
+bool animation_draw(struct term_buf *buf, const struct occlusion *occ,
+                    uint64_t now, uint32_t dt) {
+	if(config.animation >= ARRAY_LENGTH(ANIMATIONS) || buf->canvas == NULL) {
+		return false;
+	}
+
+	const struct animation *const animation = &ANIMATIONS[buf->animation];
+	struct term_buf *view = buf->governor.view;
+	uint8_t sx = governor_scale_x(&buf->governor);
+	uint8_t sy = governor_scale_y(&buf->governor);
+
+	if(sx == 1 && sy == 1) {
+		return animation->draw(buf->animation_state, buf, occ, now, dt);
+	}
+
+	if(view->canvas == NULL) {
+		return false;
+	}
+
+	struct occlusion scaled;
+	occlusion_scale(occ, &scaled, sx, sy);
+
+	if(!animation->draw(buf->animation_state, view, &scaled, now, dt)) {
+		return false;
+	}
 
-	animation->draw(buf->animation_state, buf);
+	animation_upscale(view, buf, sx, sy);
+	return true;
 }
 
-void animation_init(struct term_buf *buf) {
+// shows the frame the render thread finished and has it draw the next one;
+// returns whether the animation layer changed
+bool animate(struct term_buf *buf) {
 	if(config.animation >= ARRAY_LENGTH(ANIMATIONS)) {
-		return;
+		return false;
 	}
 
-	buf->init_width = tb_width();
-	buf->init_height = tb_height();
+	uint64_t now = monotonic_ms();
+	uint64_t dt = now - buf->animation_time;
+	uint32_t cost_us;
+	bool changed;
+
+	pressure_sample(now);
+
+	uint8_t stretch = pressure_stretch();
+	uint64_t max_dt = (uint64_t)ANIMATION_MAX_DT * stretch;
+
+	dt = dt < max_dt ? dt : max_dt;
 
-	const struct animation *const animation = &ANIMATIONS[config.animation];
-	buf->animation_state = animation->init(buf);
+	// the previous frame is late, the screen goes on without it
+	if(!render_collect(buf, &changed, &cost_us)) {
+		buf->animation_due = now + buf->animation_tick / 4 + 1;
+		return false;
+	}
+
+	// the render thread is idle until the next frame is handed out, so the
+	// state can be rebuilt for another resolution in between; the animations
+	// only write the cells they change, so what the previous resolution left
+	// on the canvas is cleared
+	if(changed && governor_sample(&buf->governor, cost_us)) {
+		animation_drop(buf);
+		render_clear(buf);
+		animation_build(buf);
+
+		struct rect all = {0, 0, buf->width, buf->height};
+		layer_damage(&buf->comp, LAYER_ANIMATION, all);
+	}
+
+	render_kick(buf, now, dt);
+	buf->animation_time = now;
+	buf->animation_due = now + (uint64_t)buf->animation_tick * stretch;
+
+	return changed;
 }
 
-void animation_free(struct term_buf *buf) {
+// milliseconds until the animation takes its next step
+int animation_timeout(struct term_buf *buf) {
+	uint64_t now = monotonic_ms();
+
+	return now >= buf->animation_due ? 0 : buf->animation_due - now;
+}
+
+void animation_init(struct term_buf *buf) // throws
+{
 	if(config.animation >= ARRAY_LENGTH(ANIMATIONS)) {
 		return;
 	}
 
-	const struct animation *const animation = &ANIMATIONS[config.animation];
+	buf->init_width = tb_width();
+	buf->init_height = tb_height();
+	buf->animation_time = monotonic_ms();
+	buf->animation = config.animation;
 
-	animation->free(buf->animation_state);
-}
+	if(buf->animation == 0) {
+		struct rng rng;
+		rng_instance(&rng);
+		buf->animation = rng_below(&rng, ARRAY_LENGTH(ANIMATIONS) - 1) + 1;
+	}
 
-// Random animation //
+	// frames are never closer than min_refresh_delta, whatever the animation
+	// asks for
+	const struct animation *const animation = &ANIMATIONS[buf->animation];
+	buf->animation_tick = animation->tick;
 
-struct random_state {
-	const struct animation *animation;
-	void *animation_state;
-};
+	if(buf->animation_tick < config.min_refresh_delta) {
+		buf->animation_tick = config.min_refresh_delta;
+	}
+
+	buf->animation_due = buf->animation_time + buf->animation_tick;
 
-static struct random_state *random_init(struct term_buf *buf) {
-	const size_t animation_idx =
-		((size_t)rand()) % (ARRAY_LENGTH(ANIMATIONS) - 1) + 1;
+	pressure_init();
+	governor_init(&buf->governor, config.animation_budget);
+	buf->governor.view = malloc_or_throw(sizeof(*buf->governor.view));
+	memset(buf->governor.view, 0, sizeof(*buf->governor.view));
+
+	animation_build(buf);
+	render_start(buf);
+}
+
+// rebuilds the animation state for the size the layout settled on, the
+// render thread is idle while the layers are resized
+void animation_resize(struct term_buf *buf) // throws
+{
+	if(config.animation >= ARRAY_LENGTH(ANIMATIONS)) {
+		return;
+	}
 
-	struct random_state *state = malloc_or_throw(sizeof(*state));
+	render_resize(buf);
 
-	state->animation = &ANIMATIONS[animation_idx];
-	state->animation_state = state->animation->init(buf);
+	if((buf->width == buf->init_width) && (buf->height == buf->init_height)) {
+		return;
+	}
 
-	return state;
+	animation_drop(buf);
+	buf->init_width = buf->width;
+	buf->init_height = buf->height;
+	animation_build(buf);
 }
 
-static void random_free(struct random_state *state) {
-	state->animation->free(state->animation_state);
-	free(state);
+void animation_free(struct term_buf *buf) {
+	if(config.animation >= ARRAY_LENGTH(ANIMATIONS)) {
+		return;
+	}
+
+	render_stop(buf);
+	pressure_free();
+	animation_drop(buf);
+	free(buf->governor.view->canvas);
+	free(buf->governor.view->canvas_damage);
+	free(buf->governor.view);
+	buf->governor.view = NULL;
 }
 
-static void random_draw(struct random_state *state, struct term_buf *term_buf) {
-	state->animation->draw(state->animation_state, term_buf);
+// frees the animation and clears what it left on screen
+void animation_stop(struct term_buf *buf) {
+	const struct tb_cell clear = {0};
+
+	animation_free(buf);
+	layer_fill(&buf->comp, LAYER_ANIMATION, 0, 0, buf->comp.width,
+	           buf->comp.height, &clear);
 }
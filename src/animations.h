@@ -3,8 +3,16 @@
 #include "draw.h"
 #include "stddef.h"
 
-void animate(struct term_buf *buf);
-void animation_init(struct term_buf *buf);
+#include <stdbool.h>
+#include <stdint.h>
+
+bool animation_draw(struct term_buf *buf, const struct occlusion *occ,
+                    uint64_t now, uint32_t dt);
+bool animate(struct term_buf *buf);
+int animation_timeout(struct term_buf *buf);
+void animation_init(struct term_buf *buf); // throws
+void animation_resize(struct term_buf *buf); // throws
 void animation_free(struct term_buf *buf);
+void animation_stop(struct term_buf *buf);
 
 extern const size_t NUM_ANIMATIONS;
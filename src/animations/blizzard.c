@@ -1,77 +1,141 @@
 #include "blizzard.h"
 
-#include "bits/time.h"
+#include "animations/utils/rng.h"
+#include "colour.h"
 #include "draw.h"
+#include "pool.h"
 #include "stdlib.h"
 #include "termbox2.h"
 #include "utils.h"
 #include <stdint.h>
-#include <time.h>
 
-#include "utils/mtwister.h"
+// every cell is hashed from the row seed and the column under the key, so
+// there is no generator state to advance; the snow only moves when the tick
+// does, which counts the steps the elapsed time added up to
+struct blizzard_state {
+	uint64_t key;
+	uint64_t ticks;
+	uint32_t elapsed;
+};
+
+// kinds of flakes, one in 25 cells shows one
+#define BLIZZARD_FLAKES 4
+
+// the cells are independent of each other, so the rows are split over the
+// threads of the pool in bands
+struct blizzard_job {
+	struct blizzard_state *state;
+	struct term_buf *term_buf;
+	const struct occlusion *occ;
+	const struct tb_cell *snow_cells;
+	struct tb_cell empty_cell;
+};
+
+// a row shows what the row above showed one tick earlier, moved one column
+// to the left, so the snow falls diagonally
+static void blizzard_band(void *ctx, uint8_t band, uint8_t bands) {
+	const struct blizzard_job *job = ctx;
+	struct term_buf *term_buf = job->term_buf;
+	struct tb_cell *buf = term_buf->canvas;
+	uint64_t key = job->state->key;
+	uint16_t start;
+	uint16_t stop;
+
+	pool_span(term_buf->height, band, bands, &start, &stop);
+
+	for(uint16_t y = start; y < stop; y++) {
+		const uint64_t seed = (job->state->ticks + term_buf->height) - y;
+		struct tb_cell *row = buf + (size_t)y * term_buf->width;
+		uint16_t end;
+
+		for(uint16_t x = 0; x < term_buf->width; x = end) {
+			bool hidden = occlusion_run(job->occ, x, y, &end);
+			end = end < term_buf->width ? end : term_buf->width;
+
+			if(hidden) {
+				continue;
+			}
+
+			for(uint16_t i = x; i < end; i++) {
+				// the upper half is scaled to 0..99 without a division
+				uint64_t hash = rng_hash(key, (seed << 32) + i + y) >> 32;
+				uint64_t snow_num = (hash * 25 * BLIZZARD_FLAKES) >> 32;
+
+				if(snow_num < BLIZZARD_FLAKES) {
+					row[i] = job->snow_cells[snow_num];
+				} else {
+					row[i] = job->empty_cell;
+				}
+			}
+		}
+
+		span_add(&term_buf->canvas_damage[y], 0, term_buf->width);
+	}
+}
 
 void *blizzard_init(struct term_buf *buf) {
+	struct blizzard_state *state = malloc_or_throw(sizeof(*state));
+	struct rng rng;
+
 	UNUSED(buf);
-	return NULL;
+	rng_instance(&rng);
+	state->key = ((uint64_t)rng_next(&rng) << 32) | rng_next(&rng);
+	state->ticks = 0;
+	// the first call paints right away
+	state->elapsed = BLIZZARD_TICK_MS;
+
+	return state;
 }
 
-void blizzard_free(void *state) { UNUSED(state); }
+void blizzard_free(void *state) { free(state); }
 
-void blizzard_draw(void *state, struct term_buf *term_buf) {
-	struct tb_cell *buf = tb_cell_buffer();
+bool blizzard_draw(void *state, struct term_buf *term_buf,
+                   const struct occlusion *occ, uint64_t now, uint32_t dt) {
+	struct blizzard_state *s = state;
 
-	const struct tb_cell snow_cells[] = {
+	const struct tb_cell snow_cells[BLIZZARD_FLAKES] = {
 		{
 			.ch = '#',
-			.fg = 8,
-			.bg = 0,
+			.fg = colour_basic(TB_WHITE),
+			.bg = TB_DEFAULT,
 		},
 		{
 			.ch = '#',
-			.fg = 8,
-			.bg = 0,
+			.fg = colour_basic(TB_WHITE),
+			.bg = TB_DEFAULT,
 		},
 		{
 			.ch = '+',
-			.fg = 8,
-			.bg = 0,
+			.fg = colour_basic(TB_WHITE),
+			.bg = TB_DEFAULT,
 		},
 		{
 			.ch = '*',
-			.fg = 7,
-			.bg = 0,
+			.fg = colour_basic(TB_CYAN),
+			.bg = TB_DEFAULT,
 		},
 	};
 
 	const struct tb_cell empty_cell = {
 		.ch = ' ',
-		.fg = 9,
-		.bg = 0,
+		.fg = TB_DEFAULT,
+		.bg = TB_DEFAULT,
 	};
 
-	const clock_t time = clock();
-	const uint64_t vertical_ticks = time / (CLOCKS_PER_SEC / 400);
+	UNUSED(now);
+	s->elapsed += dt;
 
-	for(uint64_t y = 0; y < term_buf->height; y++) {
-		const uint64_t seed = (vertical_ticks + term_buf->height) - y;
-		MTRand rng = seedRand(seed);
+	uint32_t steps = s->elapsed / BLIZZARD_TICK_MS;
+	s->elapsed -= steps * BLIZZARD_TICK_MS;
 
-		const uint64_t horizontal_offset = y;
-		for(uint64_t i = 0; i < horizontal_offset; i++) {
-			genRandLong(&rng);
-		}
+	if(steps == 0) {
+		return false;
+	}
 
-		for(uint64_t x = 0; x < term_buf->width; x++) {
-			size_t snow_num =
-				genRandLong(&rng) % (25 * ARRAY_LENGTH(snow_cells));
+	s->ticks += steps;
 
-			if(snow_num < ARRAY_LENGTH(snow_cells)) {
-				buf[y * term_buf->width + x] = snow_cells[snow_num];
-			} else {
-				buf[y * term_buf->width + x] = empty_cell;
-			}
-		}
-	}
+	struct blizzard_job job = {s, term_buf, occ, snow_cells, empty_cell};
+	pool_run(blizzard_band, &job);
 
-	UNUSED(state);
+	return true;
 }
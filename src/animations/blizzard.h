@@ -2,6 +2,12 @@
 
 #include "draw.h"
 
+#include <stdbool.h>
+
+// the snow falls one row every BLIZZARD_TICK_MS
+#define BLIZZARD_TICK_MS 50
+
 void *blizzard_init(struct term_buf *buf);
 void blizzard_free(void *state);
-void blizzard_draw(void *state, struct term_buf *term_buf);
+bool blizzard_draw(void *state, struct term_buf *term_buf,
+                   const struct occlusion *occ, uint64_t now, uint32_t dt);
@@ -1,77 +1,228 @@
+#include "animations/doom.h"
+#include "animations/utils/rng.h"
+#include "colour.h"
+#include "pool.h"
 #include "utils.h"
 #include <stdlib.h>
 #include <string.h>
 
 #define DOOM_STEPS 13
 
+// the fire in the eight basic colours, drawn with shade blocks
+static const struct tb_cell fire_basic[DOOM_STEPS] = {
+	{' ', 9, 0},    // default
+	{0x2591, 2, 0}, // red
+	{0x2592, 2, 0}, // red
+	{0x2593, 2, 0}, // red
+	{0x2588, 2, 0}, // red
+	{0x2591, 4, 2}, // yellow
+	{0x2592, 4, 2}, // yellow
+	{0x2593, 4, 2}, // yellow
+	{0x2588, 4, 2}, // yellow
+	{0x2591, 8, 4}, // white
+	{0x2592, 8, 4}, // white
+	{0x2593, 8, 4}, // white
+	{0x2588, 8, 4}, // white
+};
+
+// colour stops of the fire in the 256 and truecolor modes, from the embers
+// to the hottest cells
+#define DOOM_STOPS 6
+
+static const uint8_t fire_stops[DOOM_STOPS][3] = {
+	{0, 0, 0},     {96, 0, 0},    {200, 24, 0},
+	{255, 120, 0}, {255, 220, 32}, {255, 255, 255},
+};
+
+// the heat of every cell, row-major, with the always burning bottom row
+// last; a step reads `heat` and writes `next`, so the rows can be split
+// over the threads of the pool in bands; every band has its own generator
+// and row of random bytes in `noise`, and `elapsed` is the time not yet
+// turned into steps
 struct doom_state {
-	uint8_t *buf;
+	uint8_t *heat;
+	uint8_t *next;
+	uint32_t *noise;
+	uint16_t width;
+	uint16_t height;
+	uint16_t noise_len;
+	uint32_t elapsed;
+	struct rng rng[POOL_MAX];
+	struct tb_cell fire[DOOM_STEPS];
 };
 
+// what the bands of one step need besides the state
+struct doom_job {
+	struct doom_state *state;
+	struct term_buf *term_buf;
+	const struct occlusion *occ;
+	// the bands paint their rows after the last step
+	bool paint;
+};
+
+// the colour modes fill whole cells with a gradient instead of shading them,
+// only the background changes between neighbouring cells
+static void fire_gradient(struct tb_cell *fire) {
+	fire[0] = (struct tb_cell){' ', TB_DEFAULT, TB_DEFAULT};
+
+	for(int i = 1; i < DOOM_STEPS; ++i) {
+		int pos = i * (DOOM_STOPS - 1) * 256 / (DOOM_STEPS - 1);
+		int stop = pos / 256;
+		int frac = pos % 256;
+		const uint8_t *a = fire_stops[stop];
+		const uint8_t *b = fire_stops[stop < DOOM_STOPS - 1 ? stop + 1 : stop];
+		uint8_t rgb[3];
+
+		for(int c = 0; c < 3; ++c) {
+			rgb[c] = (a[c] * (256 - frac) + b[c] * frac) / 256;
+		}
+
+		fire[i] = (struct tb_cell){' ', TB_DEFAULT,
+		                           colour_rgb(rgb[0], rgb[1], rgb[2])};
+	}
+}
+
 struct doom_state *doom_init(struct term_buf *buf) {
 	struct doom_state *state = malloc_or_throw(sizeof(*state));
 
-	uint16_t tmp_len = buf->width * buf->height;
-	state->buf = malloc_or_throw(tmp_len);
-	tmp_len -= buf->width;
+	size_t len = (size_t)buf->width * buf->height;
+	state->noise_len = (buf->width + 3) / 4;
+	state->heat = malloc_or_throw(len);
+	state->next = malloc_or_throw(len);
+	state->noise = malloc_or_throw((size_t)POOL_MAX * state->noise_len *
+	                               sizeof(*state->noise));
+	state->width = buf->width;
+	state->height = buf->height;
+	state->elapsed = 0;
+
+	for(uint8_t i = 0; i < POOL_MAX; ++i) {
+		rng_instance(&state->rng[i]);
+	}
 
-	memset(state->buf, 0, tmp_len);
-	memset(state->buf + tmp_len, DOOM_STEPS - 1, buf->width);
+	// the bottom row is never written, both buffers keep it burning
+	if(len > 0) {
+		memset(state->heat, 0, len - buf->width);
+		memset(state->heat + len - buf->width, DOOM_STEPS - 1, buf->width);
+		memcpy(state->next, state->heat, len);
+	}
+
+	if(colour_mode() == TB_OUTPUT_NORMAL) {
+		memcpy(state->fire, fire_basic, sizeof(fire_basic));
+	} else {
+		fire_gradient(state->fire);
+	}
 
 	return state;
 }
 
 void doom_free(struct doom_state *state) {
-	free(state->buf);
+	free(state->heat);
+	free(state->next);
+	free(state->noise);
 	free(state);
 }
 
-void doom(struct doom_state *state, struct term_buf *term_buf) {
-	static struct tb_cell fire[DOOM_STEPS] = {
-		{' ', 9, 0},    // default
-		{0x2591, 2, 0}, // red
-		{0x2592, 2, 0}, // red
-		{0x2593, 2, 0}, // red
-		{0x2588, 2, 0}, // red
-		{0x2591, 4, 2}, // yellow
-		{0x2592, 4, 2}, // yellow
-		{0x2593, 4, 2}, // yellow
-		{0x2588, 4, 2}, // yellow
-		{0x2591, 8, 4}, // white
-		{0x2592, 8, 4}, // white
-		{0x2593, 8, 4}, // white
-		{0x2588, 8, 4}, // white
-	};
-
-	uint16_t src;
-	uint16_t random;
-	uint16_t dst;
-
-	uint16_t w = term_buf->init_width;
-	uint8_t *tmp = state->buf;
-
-	struct tb_cell *buf = tb_cell_buffer();
-
-	for(uint16_t x = 0; x < w; ++x) {
-		for(uint16_t y = 1; y < term_buf->init_height; ++y) {
-			src = y * w + x;
-			random = ((rand() % 7) & 3);
-			dst = src - random + 1;
-
-			if(w > dst) {
-				dst = 0;
-			} else {
-				dst -= w;
-			}
+// every cell takes the heat of a cell in the row below, up to two cells to
+// its right or one to its left, and cools by one step half of the time; the
+// fire rises one row per step
+static void doom_spread(struct doom_state *state, uint8_t band,
+                        uint16_t start, uint16_t end) {
+	uint16_t w = state->width;
+	uint32_t *words = state->noise + (size_t)band * state->noise_len;
+	const uint8_t *noise = (const uint8_t *)words;
+
+	for(uint16_t y = start; y < end && y + 1 < state->height; ++y) {
+		uint8_t *row = state->next + (size_t)y * w;
+		const uint8_t *below = state->heat + (size_t)(y + 1) * w;
+
+		rng_fill(&state->rng[band], words, state->noise_len);
+
+		for(uint16_t x = 0; x < w; ++x) {
+			// one random byte per cell, scaled to 0 to 6 first to keep
+			// the odds of the original `(rand() % 7) & 3`
+			uint8_t shift = ((noise[x] * 7) >> 8) & 3;
+
+			int src = x + shift - 1;
+			src = src < 0 ? 0 : src >= w ? w - 1 : src;
 
-			tmp[dst] = tmp[src] - (random & 1);
+			uint8_t cool = shift & 1;
+			uint8_t value = below[src];
 
-			if(tmp[dst] > 12) {
-				tmp[dst] = 0;
+			row[x] = value > cool ? value - cool : 0;
+		}
+	}
+}
+
+// the fire keeps burning under the box, only its cells are skipped; the
+// palette lookup has no branches so the runs are copied in one go
+static void doom_paint(struct doom_state *state, struct term_buf *term_buf,
+                       const struct occlusion *occ, uint16_t start,
+                       uint16_t end) {
+	const struct tb_cell *fire = state->fire;
+	struct tb_cell *buf = term_buf->canvas;
+	uint16_t stride = term_buf->width;
+	uint16_t w = state->width < stride ? state->width : stride;
+	end = end < term_buf->height ? end : term_buf->height;
+
+	for(uint16_t y = start; y < end; ++y) {
+		const uint8_t *heat = state->next + (size_t)y * state->width;
+		struct tb_cell *row = buf + (size_t)y * stride;
+		uint16_t run_end;
+
+		for(uint16_t x = 0; x < w; x = run_end) {
+			bool hidden = occlusion_run(occ, x, y, &run_end);
+			run_end = run_end < w ? run_end : w;
+
+			if(hidden) {
+				continue;
 			}
 
-			buf[dst] = fire[tmp[dst]];
-			buf[src] = fire[tmp[src]];
+			for(uint16_t i = x; i < run_end; ++i) {
+				row[i] = fire[heat[i]];
+			}
 		}
+
+		span_add(&term_buf->canvas_damage[y], 0, w);
+	}
+}
+
+// a band only paints the rows it spread itself, so one pass of the pool
+// does both
+static void doom_band(void *ctx, uint8_t band, uint8_t bands) {
+	struct doom_job *job = ctx;
+	uint16_t start;
+	uint16_t end;
+
+	pool_span(job->state->height, band, bands, &start, &end);
+	doom_spread(job->state, band, start, end);
+
+	if(job->paint) {
+		doom_paint(job->state, job->term_buf, job->occ, start, end);
 	}
 }
+
+bool doom(struct doom_state *state, struct term_buf *term_buf,
+          const struct occlusion *occ, uint64_t now, uint32_t dt) {
+	UNUSED(now);
+	state->elapsed += dt;
+
+	uint32_t steps = state->elapsed / DOOM_STEP_MS;
+	state->elapsed -= steps * DOOM_STEP_MS;
+
+	if(steps == 0 || state->width == 0) {
+		return false;
+	}
+
+	struct doom_job job = {state, term_buf, occ, false};
+
+	for(uint32_t i = 0; i < steps; ++i) {
+		job.paint = i + 1 == steps;
+		pool_run(doom_band, &job);
+
+		uint8_t *heat = state->heat;
+		state->heat = state->next;
+		state->next = heat;
+	}
+
+	return true;
+}
@@ -2,6 +2,12 @@
 
 #include "draw.h"
 
+#include <stdbool.h>
+
+// the fire rises one row every DOOM_STEP_MS
+#define DOOM_STEP_MS 33
+
 struct doom_state *doom_init(struct term_buf *buf);
 void doom_free(struct doom_state *state);
-void doom(struct doom_state *state, struct term_buf *term_buf);
+bool doom(struct doom_state *state, struct term_buf *term_buf,
+          const struct occlusion *occ, uint64_t now, uint32_t dt);
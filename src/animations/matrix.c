@@ -1,176 +1,260 @@
 #include "animations/matrix.h"
+#include "animations/utils/rng.h"
+#include "colour.h"
+#include "pool.h"
 #include "utils.h"
 #include <stdlib.h>
+#include <string.h>
 
-struct matrix_dot {
-	int val;
-	bool is_head;
-};
+// most streams a column shows at once
+#define MATRIX_STREAMS 8
+
+// Allowed codepoints
+#define MATRIX_RANDMIN 33
+#define MATRIX_RANDNUM (123 - MATRIX_RANDMIN)
 
+// only every other terminal column is used; the streams of a column all move
+// at the column's speed, so the oldest one always leaves the screen first and
+// they are kept in a ring of MATRIX_STREAMS slots starting at `first`; the
+// columns are split over the threads of the pool in bands, each with its own
+// generator and rows of damage
 struct matrix_state {
-	struct matrix_dot **grid;
-	int *length;
-	int *spaces;
-	int *updates;
+	uint16_t columns;
+	uint16_t height;
+	int frame;
+	uint32_t elapsed;
+	struct rng rng[POOL_MAX];
+	struct span *damage;
+
+	// per column
+	uint16_t *spaces;
+	uint8_t *updates;
+	uint8_t *first;
+	uint8_t *streams;
+
+	// per stream slot, the lit rows are `tail` to `head`
+	int16_t *head;
+	int16_t *tail;
+	uint16_t *length;
 };
 
 // Adapted from cmatrix
 struct matrix_state *matrix_init(struct term_buf *buf) {
 	struct matrix_state *s = malloc_or_throw(sizeof(*s));
+	uint16_t columns = (buf->width + 1) / 2;
+	size_t slots = (size_t)columns * MATRIX_STREAMS;
 
-	uint16_t len = buf->height + 1;
-	s->grid = malloc_or_throw(sizeof(*s->grid) * len); // NOLINT
-
-	len = (buf->height + 1) * buf->width;
-	(s->grid)[0] = malloc_or_throw(sizeof((s->grid)[0]) * len); // NOLINT
-
-	for(int i = 1; i <= buf->height; ++i) {
-		s->grid[i] = s->grid[i - 1] + buf->width;
+	s->columns = columns;
+	s->height = buf->height;
+	s->frame = 3;
+	s->elapsed = 0;
+	for(uint8_t i = 0; i < POOL_MAX; ++i) {
+		rng_instance(&s->rng[i]);
 	}
 
-	s->length = malloc_or_throw(buf->width * sizeof(*s->length));
-
-	s->spaces = malloc_or_throw(buf->width * sizeof(*s->spaces));
-
-	s->updates = malloc_or_throw(buf->width * sizeof(*s->updates));
+	s->spaces = malloc_or_throw(columns * sizeof(*s->spaces));
+	s->updates = malloc_or_throw(columns * sizeof(*s->updates));
+	s->first = malloc_or_throw(columns * sizeof(*s->first));
+	s->streams = malloc_or_throw(columns * sizeof(*s->streams));
+	s->head = malloc_or_throw(slots * sizeof(*s->head));
+	s->tail = malloc_or_throw(slots * sizeof(*s->tail));
+	s->length = malloc_or_throw(slots * sizeof(*s->length));
+	s->damage = malloc_or_throw((size_t)POOL_MAX * buf->height *
+	                            sizeof(*s->damage));
+	memset(s->damage, 0, (size_t)POOL_MAX * buf->height * sizeof(*s->damage));
 
 	if(buf->height <= 3) {
 		return s;
 	}
 
-	// Initialize grid
-	for(int i = 0; i <= buf->height; ++i) {
-		for(int j = 0; j <= buf->width - 1; j += 2) {
-			s->grid[i][j].val = -1;
-		}
+	for(uint16_t c = 0; c < columns; ++c) {
+		s->spaces[c] = rng_below(&s->rng[0], buf->height) + 1;
+		s->updates[c] = rng_below(&s->rng[0], 3) + 1;
+		s->first[c] = 0;
+		s->streams[c] = 0;
 	}
 
-	for(int j = 0; j < buf->width; j += 2) {
-		s->spaces[j] = (int)rand() % buf->height + 1;
-		s->length[j] = (int)rand() % (buf->height - 3) + 3;
-		s->grid[1][j].val = ' ';
-		s->updates[j] = (int)rand() % 3 + 1;
+	return s;
+}
+
+static uint32_t matrix_glyph(struct rng *rng) {
+	return rng_below(rng, MATRIX_RANDNUM) + MATRIX_RANDMIN;
+}
+
+// the canvas holds the glyphs, cells under the login box are left alone;
+// the cell is counted as changed in the rows of the band
+static struct tb_cell *matrix_cell(struct term_buf *buf,
+                                   const struct occlusion *occ,
+                                   struct span *damage, int x, int y) {
+	uint16_t end;
+
+	if(y < 0 || y >= buf->height || x >= buf->width ||
+	   occlusion_run(occ, x, y, &end)) {
+		return NULL;
 	}
 
-	return s;
+	span_add(&damage[y], x, x + 1);
+	return &buf->canvas[y * buf->width + x];
 }
 
-// Adapted from cmatrix
-void matrix(struct matrix_state *s, struct term_buf *buf) {
-	static int frame = 3;
-	const int frame_delay = 8;
-	static int count = 0;
-	bool first_col;
-
-	// Allowed codepoints
-	const int randmin = 33;
-	const int randnum = 123 - randmin;
-	// Chars change mid-scroll
-	const bool changes = true;
+// moves every stream of a column one row down, only the cells the heads
+// enter and leave and the tails leave are written
+static void matrix_column(struct matrix_state *s, struct rng *rng,
+                          struct span *damage, struct term_buf *buf,
+                          const struct occlusion *occ, uint16_t c,
+                          uintattr_t trail, uintattr_t head) {
+	const struct tb_cell clear = {0};
+	size_t base = (size_t)c * MATRIX_STREAMS;
+	int x = 2 * c;
+	int h = s->height;
 
-	if(buf->height <= 3) {
-		return;
+	// a new stream starts once the top of the column is free again
+	uint8_t newest = (s->first[c] + s->streams[c] - 1) % MATRIX_STREAMS;
+
+	if((s->streams[c] == 0 || s->tail[base + newest] > 0) &&
+	   s->streams[c] < MATRIX_STREAMS) {
+		if(s->spaces[c] > 0) {
+			s->spaces[c]--;
+		} else {
+			size_t k = base + (s->first[c] + s->streams[c]) % MATRIX_STREAMS;
+
+			// it enters from the row above the screen
+			s->head[k] = -1;
+			s->tail[k] = -1;
+			s->length[k] = rng_below(rng, h - 3) + 3;
+			s->streams[c]++;
+			s->spaces[c] = rng_below(rng, h) + 1;
+		}
 	}
 
-	count += 1;
-	if(count > frame_delay) {
-		frame += 1;
-		if(frame > 4)
-			frame = 1;
-		count = 0;
-
-		for(int j = 0; j < buf->width; j += 2) {
-			int tail;
-			if(frame > s->updates[j]) {
-				if(s->grid[0][j].val == -1 && s->grid[1][j].val == ' ') {
-					if(s->spaces[j] > 0) {
-						s->spaces[j]--;
-					} else {
-						s->length[j] = (int)rand() % (buf->height - 3) + 3;
-						s->grid[0][j].val = (int)rand() % randnum + randmin;
-						s->spaces[j] = (int)rand() % buf->height + 1;
-					}
-				}
-
-				int i = 0, seg_len = 0;
-				first_col = 1;
-				while(i <= buf->height) {
-					// Skip over spaces
-					while(i <= buf->height && (s->grid[i][j].val == ' ' ||
-					                           s->grid[i][j].val == -1)) {
-						i++;
-					}
-
-					if(i > buf->height)
-						break;
-
-					// Find the head of this col
-					tail = i;
-					seg_len = 0;
-					while(i <= buf->height && (s->grid[i][j].val != ' ' &&
-					                           s->grid[i][j].val != -1)) {
-						s->grid[i][j].is_head = false;
-						if(changes) {
-							if(rand() % 8 == 0)
-								s->grid[i][j].val =
-									(int)rand() % randnum + randmin;
-						}
-						i++;
-						seg_len++;
-					}
-
-					// Head's down offscreen
-					if(i > buf->height) {
-						s->grid[tail][j].val = ' ';
-						continue;
-					}
-
-					s->grid[i][j].val = (int)rand() % randnum + randmin;
-					s->grid[i][j].is_head = true;
-
-					if(seg_len > s->length[j] || !first_col) {
-						s->grid[tail][j].val = ' ';
-						s->grid[0][j].val = -1;
-					}
-					first_col = 0;
-					i++;
-				}
+	for(uint8_t n = 0; n < s->streams[c]; ++n) {
+		size_t k = base + (s->first[c] + n) % MATRIX_STREAMS;
+		struct tb_cell *cell;
+
+		if(s->head[k] < h) {
+			if((cell = matrix_cell(buf, occ, damage, x, s->head[k])) != NULL) {
+				cell->fg = trail;
+			}
+
+			s->head[k]++;
+
+			if((cell = matrix_cell(buf, occ, damage, x, s->head[k])) != NULL) {
+				*cell = (struct tb_cell){matrix_glyph(rng), head, TB_DEFAULT};
+			}
+		}
+
+		// the trail only grows while the head is on screen
+		if(s->head[k] >= h || s->head[k] - s->tail[k] + 1 > s->length[k]) {
+			if((cell = matrix_cell(buf, occ, damage, x, s->tail[k])) != NULL) {
+				*cell = clear;
+			}
+
+			s->tail[k]++;
+		}
+
+		// Chars change mid-scroll
+		int lit = s->head[k] - s->tail[k];
+
+		if(lit > 0 && rng_below(rng, 8) == 0) {
+			int y = s->tail[k] + (int)rng_below(rng, lit);
+
+			if((cell = matrix_cell(buf, occ, damage, x, y)) != NULL &&
+			   cell->ch != 0) {
+				cell->ch = matrix_glyph(rng);
 			}
 		}
 	}
 
-	uint32_t blank;
-	tb_utf8_char_to_unicode(&blank, " ");
+	// the oldest stream left the screen
+	if(s->streams[c] > 0 && s->tail[base + s->first[c]] >= h) {
+		s->first[c] = (s->first[c] + 1) % MATRIX_STREAMS;
+		s->streams[c]--;
+	}
+}
 
-	for(int j = 0; j < buf->width; j += 2) {
-		for(int i = 1; i <= buf->height; ++i) {
-			uint32_t c;
-			int fg = TB_GREEN;
-			int bg = TB_DEFAULT;
+// what the bands of one frame need besides the state
+struct matrix_job {
+	struct matrix_state *s;
+	struct term_buf *buf;
+	const struct occlusion *occ;
+	uint32_t ticks;
+};
 
-			if(s->grid[i][j].val == -1 || s->grid[i][j].val == ' ') {
-				tb_set_cell(j, i - 1, blank, fg, bg);
-				continue;
+// a band moves its columns by all ticks of the frame at once
+static void matrix_band(void *ctx, uint8_t band, uint8_t bands) {
+	const struct matrix_job *job = ctx;
+	struct matrix_state *s = job->s;
+	uintattr_t trail = colour_basic(TB_GREEN);
+	uintattr_t head = colour_basic(TB_WHITE) | TB_BOLD;
+	int frame = s->frame;
+	struct span *damage = s->damage + (size_t)band * s->height;
+	uint16_t start;
+	uint16_t end;
+
+	pool_span(s->columns, band, bands, &start, &end);
+
+	for(uint32_t i = 0; i < job->ticks; ++i) {
+		frame = frame % 4 + 1;
+
+		for(uint16_t c = start; c < end; ++c) {
+			if(frame > s->updates[c]) {
+				matrix_column(s, &s->rng[band], damage, job->buf, job->occ, c,
+				              trail, head);
 			}
+		}
+	}
+}
+
+// hands the rows the bands changed on to the canvas
+static void matrix_damage(struct matrix_state *s, struct term_buf *buf) {
+	uint8_t bands = pool_size();
 
-			char tmp[2];
-			tmp[0] = s->grid[i][j].val;
-			tmp[1] = '\0';
-			if(tb_utf8_char_to_unicode(&c, tmp)) {
-				if(s->grid[i][j].is_head) {
-					fg = TB_WHITE | TB_BOLD;
-				}
-				tb_set_cell(j, i - 1, c, fg, bg);
+	for(uint8_t band = 0; band < bands; ++band) {
+		struct span *damage = s->damage + (size_t)band * s->height;
+
+		for(uint16_t y = 0; y < s->height; ++y) {
+			if(damage[y].end > damage[y].x) {
+				span_add(&buf->canvas_damage[y], damage[y].x, damage[y].end);
+				damage[y] = (struct span){0};
 			}
 		}
 	}
 }
 
+// Adapted from cmatrix
+bool matrix(struct matrix_state *s, struct term_buf *buf,
+            const struct occlusion *occ, uint64_t now, uint32_t dt) {
+	UNUSED(now);
+
+	if(s->height <= 3) {
+		return false;
+	}
+
+	s->elapsed += dt;
+
+	uint32_t ticks = s->elapsed / MATRIX_TICK_MS;
+	s->elapsed -= ticks * MATRIX_TICK_MS;
+
+	if(ticks == 0) {
+		return false;
+	}
+
+	struct matrix_job job = {s, buf, occ, ticks};
+	pool_run(matrix_band, &job);
+	matrix_damage(s, buf);
+	s->frame = (s->frame + ticks - 1) % 4 + 1;
+
+	return true;
+}
+
 void matrix_free(struct matrix_state *state) {
-	free(state->grid[0]);
-	free(state->grid);
-	free(state->length);
 	free(state->spaces);
 	free(state->updates);
+	free(state->first);
+	free(state->streams);
+	free(state->head);
+	free(state->tail);
+	free(state->length);
+	free(state->damage);
 	free(state);
 }
@@ -2,6 +2,12 @@
 
 #include "draw.h"
 
+#include <stdbool.h>
+
+// the columns move every MATRIX_TICK_MS
+#define MATRIX_TICK_MS 45
+
 struct matrix_state *matrix_init(struct term_buf *buf);
-void matrix(struct matrix_state *s, struct term_buf *buf);
+bool matrix(struct matrix_state *s, struct term_buf *buf,
+            const struct occlusion *occ, uint64_t now, uint32_t dt);
 void matrix_free(struct matrix_state *state);
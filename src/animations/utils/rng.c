@@ -0,0 +1,71 @@
+#include "animations/utils/rng.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// hands out the seeds of the instances, seeded once by main
+static struct rng root = {{1, 2, 3, 4}};
+
+static uint64_t splitmix64(uint64_t *state) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+static void rng_seed(struct rng *rng, uint64_t seed) {
+	uint64_t a = splitmix64(&seed);
+	uint64_t b = splitmix64(&seed);
+
+	rng->s[0] = a;
+	rng->s[1] = a >> 32;
+	rng->s[2] = b;
+	rng->s[3] = b >> 32;
+
+	// xoshiro never leaves an all zero state
+	if((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+		rng->s[0] = 1;
+	}
+}
+
+// the same seed gives the same animations, frame for frame
+void rng_init(uint64_t seed) {
+	rng_seed(&root, seed);
+}
+
+void rng_instance(struct rng *rng) {
+	uint64_t seed = ((uint64_t)rng_next(&root) << 32) | rng_next(&root);
+	rng_seed(rng, seed);
+}
+
+static uint32_t rotl(uint32_t x, int k) {
+	return (x << k) | (x >> (32 - k));
+}
+
+uint32_t rng_next(struct rng *rng) {
+	uint32_t *s = rng->s;
+	uint32_t result = rotl(s[1] * 5, 7) * 9;
+	uint32_t t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 11);
+
+	return result;
+}
+
+// 0 to bound - 1, scaled with a multiply instead of a division
+uint32_t rng_below(struct rng *rng, uint32_t bound) {
+	return ((uint64_t)rng_next(rng) * bound) >> 32;
+}
+
+// for loops which consume their randomness a row at a time, the generator
+// runs on its own and the consumer has no carried state
+void rng_fill(struct rng *rng, uint32_t *out, size_t len) {
+	for(size_t i = 0; i < len; ++i) {
+		out[i] = rng_next(rng);
+	}
+}
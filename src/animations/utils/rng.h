@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// xoshiro128**, every animation or effect owns one so that none of them
+// shares state with another or with libc's rand()
+struct rng {
+	uint32_t s[4];
+};
+
+void rng_init(uint64_t seed);
+void rng_instance(struct rng *rng);
+uint32_t rng_next(struct rng *rng);
+uint32_t rng_below(struct rng *rng, uint32_t bound);
+void rng_fill(struct rng *rng, uint32_t *out, size_t len);
+
+// a number for any counter without generator state, for cells which are
+// computed independently of each other; splitmix64 of the key and counter
+static inline uint64_t rng_hash(uint64_t key, uint64_t counter) {
+	uint64_t z = (key ^ counter) + 0x9e3779b97f4a7c15;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
@@ -0,0 +1,85 @@
+#include "arena.h"
+#include "utils.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+};
+
+static size_t align_up(size_t size) {
+	return (size + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1);
+}
+
+void arena_init(struct arena *arena, size_t cap) // throws
+{
+	arena->base = malloc_or_throw(cap);
+	arena->cap = arena->base != NULL ? cap : 0;
+	arena->used = 0;
+	arena->overflow = NULL;
+	arena->overflow_size = 0;
+}
+
+void *arena_alloc(struct arena *arena, size_t size) // throws
+{
+	size = align_up(size);
+
+	if(arena->cap - arena->used >= size) {
+		void *ptr = arena->base + arena->used;
+		arena->used += size;
+		return ptr;
+	}
+
+	// the header is padded so the returned memory keeps the arena alignment
+	size_t header = align_up(sizeof(struct arena_chunk));
+	struct arena_chunk *chunk = malloc_or_throw(header + size);
+
+	if(chunk == NULL) {
+		return NULL;
+	}
+
+	chunk->next = arena->overflow;
+	chunk->size = size;
+	arena->overflow = chunk;
+	arena->overflow_size += size;
+
+	return (uint8_t *)chunk + header;
+}
+
+static void free_overflow(struct arena *arena) {
+	while(arena->overflow != NULL) {
+		struct arena_chunk *next = arena->overflow->next;
+		free(arena->overflow);
+		arena->overflow = next;
+	}
+
+	arena->overflow_size = 0;
+}
+
+// releases all allocations, if some of them had to overflow the arena
+// grows so that the next identical frame fits in a single block
+void arena_reset(struct arena *arena) // throws
+{
+	if(arena->overflow == NULL) {
+		arena->used = 0;
+		return;
+	}
+
+	size_t cap = arena->used + arena->overflow_size;
+
+	free_overflow(arena);
+	free(arena->base);
+	arena_init(arena, cap);
+}
+
+void arena_free(struct arena *arena) {
+	free_overflow(arena);
+	free(arena->base);
+	arena->base = NULL;
+	arena->cap = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef H_LYE_ARENA
+#define H_LYE_ARENA
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct arena_chunk;
+
+// bump allocator for short-lived buffers, everything is released at once
+// by `arena_reset`
+struct arena {
+	uint8_t *base;
+	size_t cap;
+	size_t used;
+
+	// allocations which did not fit in `base` since the last reset
+	struct arena_chunk *overflow;
+	size_t overflow_size;
+};
+
+extern struct arena frame_arena;
+
+void arena_init(struct arena *arena, size_t cap); // throws
+void *arena_alloc(struct arena *arena, size_t size); // throws
+void arena_reset(struct arena *arena); // throws
+void arena_free(struct arena *arena);
+
+#endif
@@ -0,0 +1,75 @@
+#include "art.h"
+#include "colour.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// maps an art file made by lye-art, returns false when it can not be shown
+// as it is, in which case the art is left out
+bool art_open(struct art *art, const char *path) {
+	memset(art, 0, sizeof(*art));
+
+	if(path == NULL || strlen(path) == 0) {
+		return false;
+	}
+
+	// the cells are used in place, so they have to match termbox's own
+	if(sizeof(struct tb_cell) != ART_CELL_SIZE) {
+		return false;
+	}
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+
+	if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct art_header)) {
+		close(fd);
+		return false;
+	}
+
+	size_t size = st.st_size;
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(map == MAP_FAILED) {
+		return false;
+	}
+
+	const struct art_header *header = map;
+	size_t cells_size =
+		(size_t)header->width * header->height * ART_CELL_SIZE;
+
+	// the colours were quantised for one output mode by the converter
+	if(memcmp(header->magic, ART_MAGIC, sizeof(header->magic)) != 0 ||
+	   header->mode != (uint32_t)colour_mode() ||
+	   size < sizeof(*header) + cells_size) {
+		munmap(map, size);
+		return false;
+	}
+
+	art->map = map;
+	art->size = size;
+	art->width = header->width;
+	art->height = header->height;
+	art->cells =
+		(const struct tb_cell *)((const uint8_t *)map + sizeof(*header));
+
+	return true;
+}
+
+void art_close(struct art *art) {
+	if(art->map != NULL) {
+		munmap(art->map, art->size);
+	}
+
+	memset(art, 0, sizeof(*art));
+}
@@ -0,0 +1,36 @@
+#ifndef H_LYE_ART
+#define H_LYE_ART
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ART_MAGIC "lye-art1"
+#define ART_CELL_SIZE 12
+
+// on disk the header is followed by `width * height` cells, each made of the
+// codepoint and the fg and bg attributes as native 32 bit integers; cells
+// with a codepoint of 0 are transparent, like in the layers
+struct art_header {
+	char magic[8];
+	// termbox output mode the attributes are encoded for
+	uint32_t mode;
+	uint16_t width;
+	uint16_t height;
+};
+
+// a converted art file, mapped read-only and blitted as it is
+struct art {
+	void *map;
+	size_t size;
+	uint16_t width;
+	uint16_t height;
+	const struct tb_cell *cells;
+};
+
+bool art_open(struct art *art, const char *path);
+void art_close(struct art *art);
+
+#endif
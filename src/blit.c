@@ -0,0 +1,125 @@
+#include "blit.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static bool cell_eq(const struct tb_cell *a, const struct tb_cell *b) {
+	return (a->ch == b->ch) && (a->fg == b->fg) && (a->bg == b->bg);
+}
+
+// clips a rectangle to a `dst_w` by `dst_h` buffer, `sx` and `sy` receive the
+// offset of the visible part inside the source rectangle
+bool blit_clip(uint16_t dst_w, uint16_t dst_h, int *x, int *y, int *w, int *h,
+               int *sx, int *sy) {
+	*sx = 0;
+	*sy = 0;
+
+	if(*x < 0) {
+		*sx = -*x;
+		*w += *x;
+		*x = 0;
+	}
+
+	if(*y < 0) {
+		*sy = -*y;
+		*h += *y;
+		*y = 0;
+	}
+
+	if(*x + *w > dst_w) {
+		*w = dst_w - *x;
+	}
+
+	if(*y + *h > dst_h) {
+		*h = dst_h - *y;
+	}
+
+	return (*w > 0) && (*h > 0);
+}
+
+// fills `len` cells by doubling the initialized prefix, so that all but the
+// first copy are done by memcpy
+void blit_run(struct tb_cell *dst, const struct tb_cell *cell, size_t len) {
+	if(len == 0) {
+		return;
+	}
+
+	dst[0] = *cell;
+
+	for(size_t done = 1; done < len;) {
+		size_t n = done < len - done ? done : len - done;
+		memcpy(dst + done, dst, n * sizeof(*dst));
+		done += n;
+	}
+}
+
+// copies the non-transparent cells of `src` over `dst`, the loop is kept
+// branch-free so that it can be vectorised
+void blit_alpha_run(struct tb_cell *restrict dst,
+                    const struct tb_cell *restrict src, size_t len) {
+	for(size_t i = 0; i < len; ++i) {
+		const bool opaque = src[i].ch != 0;
+
+		dst[i].ch = opaque ? src[i].ch : dst[i].ch;
+		dst[i].fg = opaque ? src[i].fg : dst[i].fg;
+		dst[i].bg = opaque ? src[i].bg : dst[i].bg;
+	}
+}
+
+// copies `src` into `dst`, returns false if nothing changed, otherwise the
+// first and last changed cells are stored in `first` and `last`
+bool blit_run_diff(struct tb_cell *dst, const struct tb_cell *src, size_t len,
+                   size_t *first, size_t *last) {
+	if(len == 0 || memcmp(dst, src, len * sizeof(*dst)) == 0) {
+		return false;
+	}
+
+	size_t f = 0;
+	size_t l = len - 1;
+
+	while(f < len && cell_eq(&dst[f], &src[f])) {
+		++f;
+	}
+
+	// the memcmp may only have seen differing padding
+	if(f == len) {
+		return false;
+	}
+
+	while(l > f && cell_eq(&dst[l], &src[l])) {
+		--l;
+	}
+
+	memcpy(dst + f, src + f, (l - f + 1) * sizeof(*dst));
+	*first = f;
+	*last = l;
+
+	return true;
+}
+
+bool blit_fill_diff(struct tb_cell *dst, const struct tb_cell *cell,
+                    size_t len, size_t *first, size_t *last) {
+	size_t f = 0;
+
+	while(f < len && cell_eq(&dst[f], cell)) {
+		++f;
+	}
+
+	if(f == len) {
+		return false;
+	}
+
+	size_t l = len - 1;
+
+	while(l > f && cell_eq(&dst[l], cell)) {
+		--l;
+	}
+
+	blit_run(dst + f, cell, l - f + 1);
+	*first = f;
+	*last = l;
+
+	return true;
+}
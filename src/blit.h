@@ -0,0 +1,21 @@
+#ifndef H_LYE_BLIT
+#define H_LYE_BLIT
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+bool blit_clip(uint16_t dst_w, uint16_t dst_h, int *x, int *y, int *w, int *h,
+               int *sx, int *sy);
+
+void blit_run(struct tb_cell *dst, const struct tb_cell *cell, size_t len);
+void blit_alpha_run(struct tb_cell *restrict dst,
+                    const struct tb_cell *restrict src, size_t len);
+bool blit_run_diff(struct tb_cell *dst, const struct tb_cell *src, size_t len,
+                   size_t *first, size_t *last);
+bool blit_fill_diff(struct tb_cell *dst, const struct tb_cell *cell,
+                    size_t len, size_t *first, size_t *last);
+
+#endif
@@ -0,0 +1,135 @@
+#include "clock.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+static enum clock_resolution conversion_resolution(char c) {
+	switch(c) {
+		case 'S':
+		case 'T':
+		case 'X':
+		case 'c':
+		case 'r':
+		case 's':
+		case '+':
+			return CLOCK_SECOND;
+		case 'M':
+		case 'R':
+			return CLOCK_MINUTE;
+		// the utc offset and zone name only change with daylight saving
+		// time, which always happens on an hour boundary
+		case 'H':
+		case 'I':
+		case 'k':
+		case 'l':
+		case 'p':
+		case 'P':
+		case 'z':
+		case 'Z':
+			return CLOCK_HOUR;
+		case '%':
+		case 'n':
+		case 't':
+		case '\0':
+			return CLOCK_STATIC;
+		default:
+			return CLOCK_DAY;
+	}
+}
+
+enum clock_resolution clock_resolution(const char *fmt) {
+	enum clock_resolution resolution = CLOCK_STATIC;
+
+	while((fmt = strchr(fmt, '%')) != NULL) {
+		++fmt;
+
+		// flags, field width and the E and O modifiers
+		while(*fmt != '\0' && strchr("_-0^#123456789EO", *fmt) != NULL) {
+			++fmt;
+		}
+
+		enum clock_resolution conv = conversion_resolution(*fmt);
+
+		if(conv < resolution) {
+			resolution = conv;
+		}
+
+		if(*fmt == '\0') {
+			break;
+		}
+
+		++fmt;
+	}
+
+	return resolution;
+}
+
+// returns the first time at which a field of the given resolution changes
+time_t clock_next(enum clock_resolution resolution, time_t now) {
+	struct tm tm_info;
+
+	switch(resolution) {
+		case CLOCK_SECOND:
+			return now + 1;
+		case CLOCK_MINUTE:
+			// every timezone offset is a whole number of minutes
+			return (now / 60 + 1) * 60;
+		case CLOCK_HOUR:
+			localtime_r(&now, &tm_info);
+			tm_info.tm_hour += 1;
+			tm_info.tm_min = 0;
+			tm_info.tm_sec = 0;
+			tm_info.tm_isdst = -1;
+			return mktime(&tm_info);
+		case CLOCK_DAY:
+			localtime_r(&now, &tm_info);
+			tm_info.tm_mday += 1;
+			tm_info.tm_hour = 0;
+			tm_info.tm_min = 0;
+			tm_info.tm_sec = 0;
+			tm_info.tm_isdst = -1;
+			return mktime(&tm_info);
+		default:
+			return (time_t)-1;
+	}
+}
+
+void clock_cache_init(struct clock_cache *cache, const char *fmt) {
+	cache->fmt = fmt;
+	cache->resolution = clock_resolution(fmt);
+	cache->valid = false;
+	cache->next = 0;
+	cache->text[0] = '\0';
+	cache->len = 0;
+}
+
+// renders the format again once its text may have changed, returns true if
+// the text is new
+bool clock_cache_update(struct clock_cache *cache, time_t now) {
+	if(cache->valid &&
+	   (cache->resolution == CLOCK_STATIC || now < cache->next)) {
+		return false;
+	}
+
+	char text[CLOCK_TEXT_LEN];
+	struct tm tm_info;
+	localtime_r(&now, &tm_info);
+
+	if(strftime(text, CLOCK_TEXT_LEN, cache->fmt, &tm_info) == 0) {
+		text[0] = '\0';
+	}
+
+	cache->next = clock_next(cache->resolution, now);
+
+	if(cache->valid && strcmp(text, cache->text) == 0) {
+		return false;
+	}
+
+	memcpy(cache->text, text, CLOCK_TEXT_LEN);
+	cache->len = strlen(cache->text);
+	cache->valid = true;
+
+	return true;
+}
@@ -0,0 +1,38 @@
+#ifndef H_LYE_CLOCK
+#define H_LYE_CLOCK
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define CLOCK_TEXT_LEN 32
+
+// finest time field used by a strftime format
+enum clock_resolution {
+	CLOCK_SECOND,
+	CLOCK_MINUTE,
+	CLOCK_HOUR,
+	CLOCK_DAY,
+	CLOCK_STATIC,
+};
+
+// strftime output which is only recomputed once it may have changed
+struct clock_cache {
+	const char *fmt;
+	enum clock_resolution resolution;
+	bool valid;
+	time_t next;
+
+	char text[CLOCK_TEXT_LEN];
+	uint16_t len;
+	struct tb_cell cells[CLOCK_TEXT_LEN];
+};
+
+enum clock_resolution clock_resolution(const char *fmt);
+void clock_cache_init(struct clock_cache *cache, const char *fmt);
+bool clock_cache_update(struct clock_cache *cache, time_t now);
+time_t clock_next(enum clock_resolution resolution, time_t now);
+
+#endif
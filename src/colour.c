@@ -0,0 +1,217 @@
+#include "colour.h"
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the vga text mode palette, the first eight are the basic colours
+static const uint8_t ansi_rgb[16][3] = {
+	{0, 0, 0},       {170, 0, 0},    {0, 170, 0},    {170, 85, 0},
+	{0, 0, 170},     {170, 0, 170},  {0, 170, 170},  {170, 170, 170},
+	{85, 85, 85},    {255, 85, 85},  {85, 255, 85},  {255, 255, 85},
+	{85, 85, 255},   {255, 85, 255}, {85, 255, 255}, {255, 255, 255},
+};
+
+// channel levels of the 6x6x6 cube of the 256 colour palette
+static const uint8_t cube_levels[6] = {0, 95, 135, 175, 215, 255};
+
+static int mode = TB_OUTPUT_NORMAL;
+
+void colour_init() {
+	mode = TB_OUTPUT_NORMAL;
+
+	if(config.output_mode == NULL) {
+		return;
+	}
+
+	if(strcmp(config.output_mode, "256") == 0) {
+		mode = TB_OUTPUT_256;
+	}
+
+	// termbox only holds 24 bit colours in 32 bit attributes
+#if TB_OPT_ATTR_W == 32
+	if(strcmp(config.output_mode, "truecolor") == 0) {
+		mode = TB_OUTPUT_TRUECOLOR;
+	}
+#endif
+}
+
+int colour_mode() {
+	return mode;
+}
+
+const char *colour_mode_name() {
+	switch(mode) {
+		case TB_OUTPUT_256:
+			return "256";
+#if TB_OPT_ATTR_W == 32
+		case TB_OUTPUT_TRUECOLOR:
+			return "truecolor";
+#endif
+		default:
+			return "normal";
+	}
+}
+
+static unsigned distance(const uint8_t a[3], uint8_t r, uint8_t g, uint8_t b) {
+	int dr = a[0] - r;
+	int dg = a[1] - g;
+	int db = a[2] - b;
+
+	return dr * dr + dg * dg + db * db;
+}
+
+static uint8_t cube_level(uint8_t value) {
+	uint8_t best = 0;
+
+	for(uint8_t i = 1; i < 6; ++i) {
+		if(abs(cube_levels[i] - value) < abs(cube_levels[best] - value)) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static uint8_t nearest_256(uint8_t r, uint8_t g, uint8_t b) {
+	uint8_t cr = cube_level(r);
+	uint8_t cg = cube_level(g);
+	uint8_t cb = cube_level(b);
+	const uint8_t cube[3] = {cube_levels[cr], cube_levels[cg],
+	                         cube_levels[cb]};
+
+	// the grey ramp runs from 8 to 238 in steps of 10
+	int grey = (r + g + b) / 3;
+	int step = grey < 8 ? 0 : grey > 238 ? 23 : (grey - 8 + 5) / 10;
+	uint8_t level = 8 + step * 10;
+	const uint8_t ramp[3] = {level, level, level};
+
+	if(distance(ramp, r, g, b) < distance(cube, r, g, b)) {
+		return 232 + step;
+	}
+
+	return 16 + 36 * cr + 6 * cg + cb;
+}
+
+static uint8_t nearest_basic(uint8_t r, uint8_t g, uint8_t b) {
+	uint8_t best = 0;
+
+	for(uint8_t i = 1; i < 8; ++i) {
+		if(distance(ansi_rgb[i], r, g, b) < distance(ansi_rgb[best], r, g, b)) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+// the colour of an entry of the 256 colour palette
+static void index_rgb(uint8_t index, uint8_t rgb[3]) {
+	if(index < 16) {
+		memcpy(rgb, ansi_rgb[index], 3);
+	} else if(index < 232) {
+		rgb[0] = cube_levels[(index - 16) / 36];
+		rgb[1] = cube_levels[(index - 16) / 6 % 6];
+		rgb[2] = cube_levels[(index - 16) % 6];
+	} else {
+		memset(rgb, 8 + (index - 232) * 10, 3);
+	}
+}
+
+// one of the eight basic colours (1 to 8, anything else is the default)
+// in the current output mode
+uintattr_t colour_basic(uint8_t basic) {
+	if(basic == 0 || basic > 8) {
+		return TB_DEFAULT;
+	}
+
+	switch(mode) {
+		case TB_OUTPUT_256:
+			// index 0 is told apart from the default by TB_HI_BLACK
+			return basic == 1 ? TB_HI_BLACK : basic - 1;
+#if TB_OPT_ATTR_W == 32
+		case TB_OUTPUT_TRUECOLOR: {
+			const uint8_t *rgb = ansi_rgb[basic - 1];
+			return colour_rgb(rgb[0], rgb[1], rgb[2]);
+		}
+#endif
+		default:
+			return basic;
+	}
+}
+
+// quantises a colour to the palette of the current output mode, truecolor
+// keeps all 8 bits of every channel
+uintattr_t colour_rgb(uint8_t r, uint8_t g, uint8_t b) {
+	switch(mode) {
+		case TB_OUTPUT_256:
+			return nearest_256(r, g, b);
+#if TB_OPT_ATTR_W == 32
+		case TB_OUTPUT_TRUECOLOR: {
+			uintattr_t colour =
+				((uintattr_t)r << 16) | ((uintattr_t)g << 8) | b;
+			return colour == 0 ? TB_HI_BLACK : colour;
+		}
+#endif
+		default:
+			return nearest_basic(r, g, b) + 1;
+	}
+}
+
+// an entry of the 256 colour palette in the current output mode
+uintattr_t colour_index(uint8_t index) {
+	uint8_t rgb[3];
+
+	switch(mode) {
+		case TB_OUTPUT_256:
+			return index == 0 ? TB_HI_BLACK : index;
+		case TB_OUTPUT_NORMAL:
+			if(index < 8) {
+				return index + 1;
+			}
+
+			if(index < 16) {
+				return (index - 7) | TB_BRIGHT;
+			}
+			// fall through
+		default:
+			index_rgb(index, rgb);
+			return colour_rgb(rgb[0], rgb[1], rgb[2]);
+	}
+}
+
+// the colour a cell attribute stands for, false for the default colour
+bool colour_to_rgb(uintattr_t colour, uint8_t rgb[3]) {
+	uint8_t index = colour & 0xff;
+
+	switch(mode) {
+		case TB_OUTPUT_256:
+			if(index == 0 && !(colour & TB_HI_BLACK)) {
+				return false;
+			}
+
+			index_rgb(index, rgb);
+			return true;
+#if TB_OPT_ATTR_W == 32
+		case TB_OUTPUT_TRUECOLOR:
+			if((colour & 0xffffff) == 0 && !(colour & TB_HI_BLACK)) {
+				return false;
+			}
+
+			rgb[0] = (colour >> 16) & 0xff;
+			rgb[1] = (colour >> 8) & 0xff;
+			rgb[2] = colour & 0xff;
+			return true;
+#endif
+		default:
+			if(index == 0 || index > 8) {
+				return false;
+			}
+
+			memcpy(rgb, ansi_rgb[(colour & TB_BRIGHT) ? index + 7 : index - 1],
+			       3);
+			return true;
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef H_LYE_COLOUR
+#define H_LYE_COLOUR
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void colour_init();
+int colour_mode();
+const char *colour_mode_name();
+uintattr_t colour_basic(uint8_t basic);
+uintattr_t colour_rgb(uint8_t r, uint8_t g, uint8_t b);
+uintattr_t colour_index(uint8_t index);
+bool colour_to_rgb(uintattr_t colour, uint8_t rgb[3]);
+
+#endif
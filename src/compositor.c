@@ -0,0 +1,412 @@
+#include "compositor.h"
+#include "blit.h"
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool rect_touches(struct rect a, struct rect b) {
+	return (a.x <= b.x + b.w) && (b.x <= a.x + a.w) && (a.y <= b.y + b.h) &&
+	       (b.y <= a.y + a.h);
+}
+
+static struct rect rect_union(struct rect a, struct rect b) {
+	uint16_t x1 = a.x < b.x ? a.x : b.x;
+	uint16_t y1 = a.y < b.y ? a.y : b.y;
+	uint16_t x2 = (a.x + a.w) > (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+	uint16_t y2 = (a.y + a.h) > (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+
+	struct rect out = {x1, y1, x2 - x1, y2 - y1};
+	return out;
+}
+
+// adds a rectangle to a damage list, merging it with a touching rectangle
+// when possible, or with the last one when the list is full
+static void rect_list_add(struct rect *list, uint8_t *len, uint8_t cap,
+                          struct rect rect) {
+	for(uint8_t i = 0; i < *len; ++i) {
+		if(rect_touches(list[i], rect)) {
+			list[i] = rect_union(list[i], rect);
+			return;
+		}
+	}
+
+	if(*len < cap) {
+		list[*len] = rect;
+		++(*len);
+	} else {
+		list[cap - 1] = rect_union(list[cap - 1], rect);
+	}
+}
+
+void compositor_init(struct compositor *comp) {
+	memset(comp, 0, sizeof(*comp));
+}
+
+void compositor_free(struct compositor *comp) {
+	// all layers share the allocation of the bottom one
+	free(comp->layers[0].cells);
+	free(comp->rows);
+	compositor_init(comp);
+}
+
+void compositor_resize(struct compositor *comp, uint16_t width,
+                       uint16_t height) // throws
+{
+	compositor_free(comp);
+
+	size_t len = (size_t)width * height;
+
+	if(len == 0) {
+		return;
+	}
+
+	struct tb_cell *cells =
+		malloc_or_throw(sizeof(*cells) * len * LAYER_COUNT); // NOLINT
+
+	if(cells == NULL) {
+		return;
+	}
+
+	memset(cells, 0, sizeof(*cells) * len * LAYER_COUNT);
+
+	for(int i = 0; i < LAYER_COUNT; ++i) {
+		comp->layers[i].cells = cells + i * len;
+	}
+
+	comp->rows = malloc_or_throw(sizeof(*comp->rows) * height);
+
+	if(comp->rows == NULL) {
+		compositor_free(comp);
+		return;
+	}
+
+	memset(comp->rows, 0, sizeof(*comp->rows) * height);
+
+	comp->width = width;
+	comp->height = height;
+
+	compositor_damage_all(comp);
+}
+
+void compositor_damage_all(struct compositor *comp) {
+	struct rect all = {0, 0, comp->width, comp->height};
+
+	layer_damage(comp, LAYER_ANIMATION, all);
+}
+
+// composes bottom to top, every layer being masked over the ones below it
+static void compose_rect(struct compositor *comp, struct tb_cell *out,
+                         struct rect rect) {
+	const struct tb_cell blank = {' ', TB_DEFAULT, TB_DEFAULT};
+
+	for(uint16_t y = rect.y; y < rect.y + rect.h; ++y) {
+		size_t i = (size_t)y * comp->width + rect.x;
+
+		blit_run(out + i, &blank, rect.w);
+
+		for(int l = 0; l < LAYER_COUNT; ++l) {
+			blit_alpha_run(out + i, comp->layers[l].cells + i, rect.w);
+		}
+	}
+}
+
+// recomposes the damaged regions of all layers into `out`,
+// returns false if nothing had to be redrawn
+bool compositor_compose(struct compositor *comp, struct tb_cell *out) {
+	struct rect damage[LAYER_COUNT * LAYER_MAX_DAMAGE];
+	uint8_t damage_len = 0;
+
+	for(int l = 0; l < LAYER_COUNT; ++l) {
+		struct layer *layer = &comp->layers[l];
+
+		for(uint8_t i = 0; i < layer->damage_len; ++i) {
+			rect_list_add(damage, &damage_len, ARRAY_LENGTH(damage),
+			              layer->damage[i]);
+		}
+
+		layer->damage_len = 0;
+	}
+
+	bool composed = damage_len > 0;
+
+	if(out != NULL) {
+		for(uint8_t i = 0; i < damage_len; ++i) {
+			compose_rect(comp, out, damage[i]);
+		}
+	}
+
+	for(uint16_t y = 0; y < comp->height; ++y) {
+		struct span *row = &comp->rows[y];
+
+		if(row->end <= row->x) {
+			continue;
+		}
+
+		if(out != NULL) {
+			struct rect rect = {row->x, y, row->end - row->x, 1};
+			compose_rect(comp, out, rect);
+		}
+
+		*row = (struct span){0};
+		composed = true;
+	}
+
+	return out != NULL && composed;
+}
+
+// damages `x` to `end` of row `y`, for changes too scattered for the
+// rectangles of a layer
+void compositor_damage_row(struct compositor *comp, uint16_t y, uint16_t x,
+                           uint16_t end) {
+	end = end < comp->width ? end : comp->width;
+
+	if(y >= comp->height || end <= x) {
+		return;
+	}
+
+	span_add(&comp->rows[y], x, end);
+}
+
+void layer_damage(struct compositor *comp, enum layer_id id, struct rect rect) {
+	int x = rect.x;
+	int y = rect.y;
+	int w = rect.w;
+	int h = rect.h;
+	int sx;
+	int sy;
+
+	if(!blit_clip(comp->width, comp->height, &x, &y, &w, &h, &sx, &sy)) {
+		return;
+	}
+
+	struct rect clipped = {x, y, w, h};
+	struct layer *layer = &comp->layers[id];
+
+	rect_list_add(layer->damage, &layer->damage_len, LAYER_MAX_DAMAGE,
+	              clipped);
+}
+
+static void damage_span(int *min_x, int *min_y, int *max_x, int *max_y,
+                        int x, int y, size_t first, size_t last) {
+	*min_x = (x + (int)first) < *min_x ? (x + (int)first) : *min_x;
+	*max_x = (x + (int)last) > *max_x ? (x + (int)last) : *max_x;
+	*min_y = y < *min_y ? y : *min_y;
+	*max_y = y;
+}
+
+// copies `cells` into a layer, only the cells which actually change are
+// reported as damaged; with `alpha` set, transparent source cells are skipped
+void layer_blit(struct compositor *comp, enum layer_id id, int x, int y,
+                uint16_t w, uint16_t h, const struct tb_cell *cells,
+                bool alpha) {
+	int cw = w;
+	int ch = h;
+	int sx;
+	int sy;
+
+	if(!blit_clip(comp->width, comp->height, &x, &y, &cw, &ch, &sx, &sy)) {
+		return;
+	}
+
+	struct tb_cell *dst = comp->layers[id].cells;
+	int min_x = comp->width;
+	int min_y = comp->height;
+	int max_x = -1;
+	int max_y = -1;
+
+	for(int i = 0; i < ch; ++i) {
+		const struct tb_cell *src = cells + (size_t)(sy + i) * w + sx;
+		struct tb_cell *row = dst + (size_t)(y + i) * comp->width + x;
+		size_t first;
+		size_t last;
+
+		if(!alpha) {
+			if(blit_run_diff(row, src, cw, &first, &last)) {
+				damage_span(&min_x, &min_y, &max_x, &max_y, x, y + i, first,
+				            last);
+			}
+
+			continue;
+		}
+
+		// opaque runs are copied as a whole, transparent cells split them
+		for(int k = 0; k < cw;) {
+			if(src[k].ch == 0) {
+				++k;
+				continue;
+			}
+
+			int run = k;
+
+			while(run < cw && src[run].ch != 0) {
+				++run;
+			}
+
+			if(blit_run_diff(row + k, src + k, run - k, &first, &last)) {
+				damage_span(&min_x, &min_y, &max_x, &max_y, x + k, y + i,
+				            first, last);
+			}
+
+			k = run;
+		}
+	}
+
+	if(max_x >= 0) {
+		struct rect rect = {min_x, min_y, max_x - min_x + 1,
+		                    max_y - min_y + 1};
+		layer_damage(comp, id, rect);
+	}
+}
+
+void layer_fill(struct compositor *comp, enum layer_id id, int x, int y,
+                uint16_t w, uint16_t h, const struct tb_cell *cell) {
+	int cw = w;
+	int ch = h;
+	int sx;
+	int sy;
+
+	if(!blit_clip(comp->width, comp->height, &x, &y, &cw, &ch, &sx, &sy)) {
+		return;
+	}
+
+	struct tb_cell *dst = comp->layers[id].cells;
+	int min_x = comp->width;
+	int min_y = comp->height;
+	int max_x = -1;
+	int max_y = -1;
+
+	for(int i = 0; i < ch; ++i) {
+		struct tb_cell *row = dst + (size_t)(y + i) * comp->width + x;
+		size_t first;
+		size_t last;
+
+		if(blit_fill_diff(row, cell, cw, &first, &last)) {
+			damage_span(&min_x, &min_y, &max_x, &max_y, x, y + i, first,
+			            last);
+		}
+	}
+
+	if(max_x >= 0) {
+		struct rect rect = {min_x, min_y, max_x - min_x + 1,
+		                    max_y - min_y + 1};
+		layer_damage(comp, id, rect);
+	}
+}
+
+void layer_put(struct compositor *comp, enum layer_id id, int x, int y,
+               const struct tb_cell *cell) {
+	layer_fill(comp, id, x, y, 1, 1, cell);
+}
+
+// draws a single line of text whose position and length may vary between
+// frames, the cells covered by the previous text (`prev`) are cleared
+void layer_text(struct compositor *comp, enum layer_id id, struct rect *prev,
+                int x, int y, const struct tb_cell *cells, uint16_t len) {
+	const struct tb_cell clear = {0};
+	int end = x + len;
+
+	if(prev->w > 0) {
+		int prev_end = prev->x + prev->w;
+
+		if(prev->y != y || prev_end <= x || end <= prev->x) {
+			layer_fill(comp, id, prev->x, prev->y, prev->w, 1, &clear);
+		} else {
+			if(prev->x < x) {
+				layer_fill(comp, id, prev->x, y, x - prev->x, 1, &clear);
+			}
+
+			if(prev_end > end) {
+				layer_fill(comp, id, end, y, prev_end - end, 1, &clear);
+			}
+		}
+	}
+
+	layer_blit(comp, id, x, y, len, 1, cells, false);
+
+	int cx = x < 0 ? 0 : x;
+	int cend = end > comp->width ? comp->width : end;
+
+	if(y < 0 || y >= comp->height || cend <= cx) {
+		prev->w = 0;
+		return;
+	}
+
+	prev->x = cx;
+	prev->y = y;
+	prev->w = cend - cx;
+	prev->h = 1;
+}
+
+// widens a span to cover `x` to `end` as well
+void span_add(struct span *span, uint16_t x, uint16_t end) {
+	if(span->end <= span->x) {
+		span->x = x;
+		span->end = end;
+		return;
+	}
+
+	span->x = x < span->x ? x : span->x;
+	span->end = end > span->end ? end : span->end;
+}
+
+void occlusion_add(struct occlusion *occ, struct rect rect) {
+	if(rect.w == 0 || rect.h == 0) {
+		return;
+	}
+
+	// rectangles past the limit are dropped, which only costs the work
+	// they would have saved
+	if(occ->len < OCCLUSION_MAX) {
+		occ->rects[occ->len] = rect;
+		++occ->len;
+	}
+}
+
+// returns whether the cell at `x`, `y` is hidden, `end` receives the end of
+// the run of cells on that row sharing the same visibility
+bool occlusion_run(const struct occlusion *occ, uint16_t x, uint16_t y,
+                   uint16_t *end) {
+	bool hidden = false;
+	*end = UINT16_MAX;
+
+	// overlapping rectangles can extend a hidden run, so look again until
+	// the run stops growing
+	for(bool grown = true; grown;) {
+		grown = false;
+
+		for(uint8_t i = 0; i < occ->len; ++i) {
+			const struct rect *r = &occ->rects[i];
+
+			if(y < r->y || y >= r->y + r->h) {
+				continue;
+			}
+
+			uint16_t start = hidden ? *end : x;
+			uint16_t r_end = r->x + r->w;
+
+			if(r->x <= start && start < r_end) {
+				hidden = true;
+				*end = r_end;
+				grown = true;
+			}
+		}
+	}
+
+	if(hidden) {
+		return true;
+	}
+
+	for(uint8_t i = 0; i < occ->len; ++i) {
+		const struct rect *r = &occ->rects[i];
+
+		if(y >= r->y && y < r->y + r->h && r->x > x && r->x < *end) {
+			*end = r->x;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,87 @@
+#ifndef H_LYE_COMPOSITOR
+#define H_LYE_COMPOSITOR
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LAYER_MAX_DAMAGE 8
+#define OCCLUSION_MAX 4
+
+struct rect {
+	uint16_t x;
+	uint16_t y;
+	uint16_t w;
+	uint16_t h;
+};
+
+// columns `x` up to `end` of a row, empty while `end` is not past `x`
+struct span {
+	uint16_t x;
+	uint16_t end;
+};
+
+// layers are composed from bottom to top, cells with `ch == 0` are
+// transparent and let the layers below show through
+enum layer_id {
+	LAYER_ANIMATION,
+	LAYER_ART, // converted art from `art_file`
+	LAYER_BIGCLOCK,
+	LAYER_STATIC, // box, labels and key hints
+	LAYER_WIDGETS,
+	LAYER_STATUS,
+	LAYER_COUNT,
+};
+
+struct layer {
+	struct tb_cell *cells;
+
+	struct rect damage[LAYER_MAX_DAMAGE];
+	uint8_t damage_len;
+};
+
+// opaque rectangles of the upper layers, cells of the bottom layer under
+// them never show and do not have to be drawn
+struct occlusion {
+	struct rect rects[OCCLUSION_MAX];
+	uint8_t len;
+};
+
+// besides the rectangles of the layers, scattered changes are damaged row by
+// row in `rows`, which a handful of rectangles would merge into the screen
+struct compositor {
+	uint16_t width;
+	uint16_t height;
+
+	struct layer layers[LAYER_COUNT];
+	struct span *rows;
+};
+
+void compositor_init(struct compositor *comp);
+void compositor_free(struct compositor *comp);
+void compositor_resize(struct compositor *comp, uint16_t width,
+                       uint16_t height); // throws
+bool compositor_compose(struct compositor *comp, struct tb_cell *out);
+void compositor_damage_all(struct compositor *comp);
+void compositor_damage_row(struct compositor *comp, uint16_t y, uint16_t x,
+                           uint16_t end);
+
+void layer_damage(struct compositor *comp, enum layer_id id, struct rect rect);
+void layer_blit(struct compositor *comp, enum layer_id id, int x, int y,
+                uint16_t w, uint16_t h, const struct tb_cell *cells,
+                bool alpha);
+void layer_fill(struct compositor *comp, enum layer_id id, int x, int y,
+                uint16_t w, uint16_t h, const struct tb_cell *cell);
+void layer_put(struct compositor *comp, enum layer_id id, int x, int y,
+               const struct tb_cell *cell);
+void layer_text(struct compositor *comp, enum layer_id id, struct rect *prev,
+                int x, int y, const struct tb_cell *cells, uint16_t len);
+
+void span_add(struct span *span, uint16_t x, uint16_t end);
+
+void occlusion_add(struct occlusion *occ, struct rect rect);
+bool occlusion_run(const struct occlusion *occ, uint16_t x, uint16_t y,
+                   uint16_t *end);
+
+#endif
@@ -42,6 +42,15 @@ static void config_handle_u16(void *data, char **pars, const int pars_count) {
 	}
 }
 
+// atoi would stop at the largest int, half of the range
+static void config_handle_u32(void *data, char **pars, const int pars_count) {
+	if(strcmp(*pars, "") == 0) {
+		*((uint32_t *)data) = 0;
+	} else {
+		*((uint32_t *)data) = strtoul(*pars, NULL, 10);
+	}
+}
+
 void config_handle_str(void *data, char **pars, const int pars_count) {
 	if(*((char **)data) != NULL) {
 		free(*((char **)data));
@@ -140,6 +149,11 @@ void config_load(const char *cfg_path) {
 	struct configator_param map_no_section[] = {
 		{"animate", &config.animate, config_handle_bool},
 		{"animation", &config.animation, config_handle_u8},
+		{"animation_budget", &config.animation_budget, config_handle_u16},
+		{"animation_idle", &config.animation_idle, config_handle_bool},
+		{"animation_pressure", &config.animation_pressure, config_handle_bool},
+		{"animation_threads", &config.animation_threads, config_handle_u8},
+		{"art_file", &config.art_file, config_handle_str},
 		{"asterisk", &config.asterisk, config_handle_char},
 		{"bg", &config.bg, config_handle_u8},
 		{"bigclock", &config.bigclock, config_handle_bool},
@@ -148,6 +162,8 @@ void config_load(const char *cfg_path) {
 		{"clock", &config.clock, config_handle_str},
 		{"console_dev", &config.console_dev, config_handle_str},
 		{"default_input", &config.default_input, config_handle_u8},
+		{"fb_device", &config.fb_device, config_handle_str},
+		{"fb_geometry", &config.fb_geometry, config_handle_str},
 		{"fg", &config.fg, config_handle_u8},
 		{"hide_borders", &config.hide_borders, config_handle_bool},
 		{"hide_key_hints", &config.hide_key_hints, config_handle_bool},
@@ -161,11 +177,16 @@ void config_load(const char *cfg_path) {
 		{"max_password_len", &config.max_password_len, config_handle_u8},
 		{"mcookie_cmd", &config.mcookie_cmd, config_handle_str},
 		{"min_refresh_delta", &config.min_refresh_delta, config_handle_u16},
+		{"optimize_output", &config.optimize_output, config_handle_bool},
+		{"output_budget", &config.output_budget, config_handle_u16},
+		{"output_mode", &config.output_mode, config_handle_str},
+		{"output_stats", &config.output_stats, config_handle_str},
 		{"path", &config.path, config_handle_str},
 		{"restart_cmd", &config.restart_cmd, config_handle_str},
 		{"restart_key", &config.restart_key, config_handle_str},
 		{"save", &config.save, config_handle_bool},
 		{"save_file", &config.save_file, config_handle_str},
+		{"seed", &config.seed, config_handle_u32},
 		{"service_name", &config.service_name, config_handle_str},
 		{"shutdown_cmd", &config.shutdown_cmd, config_handle_str},
 		{"shutdown_key", &config.shutdown_key, config_handle_str},
@@ -181,7 +202,7 @@ void config_load(const char *cfg_path) {
 		{"xsessions", &config.xsessions, config_handle_str},
 	};
 
-	uint16_t map_len[] = {41};
+	uint16_t map_len[] = {53};
 	struct configator_param *map[] = {
 		map_no_section,
 	};
@@ -249,6 +270,11 @@ void lang_defaults() {
 void config_defaults() {
 	config.animate = false;
 	config.animation = 1;
+	config.animation_budget = 10;
+	config.animation_idle = false;
+	config.animation_pressure = true;
+	config.animation_threads = 1;
+	config.art_file = NULL;
 	config.asterisk = '*';
 	config.bg = 0;
 	config.bigclock = false;
@@ -257,6 +283,8 @@ void config_defaults() {
 	config.clock = NULL;
 	config.console_dev = strdup("/dev/console");
 	config.default_input = LOGIN_INPUT;
+	config.fb_device = NULL;
+	config.fb_geometry = NULL;
 	config.fg = 9;
 	config.hide_borders = false;
 	config.hide_key_hints = false;
@@ -270,12 +298,17 @@ void config_defaults() {
 	config.max_password_len = 255;
 	config.mcookie_cmd = strdup("/usr/bin/mcookie");
 	config.min_refresh_delta = 5;
+	config.optimize_output = true;
+	config.output_budget = 50;
+	config.output_mode = NULL;
+	config.output_stats = NULL;
 	config.path =
 		strdup("/sbin:/bin:/usr/local/sbin:/usr/local/bin:/usr/bin:/usr/sbin");
 	config.restart_cmd = strdup("/sbin/shutdown -r now");
 	config.restart_key = strdup("F2");
 	config.save = true;
 	config.save_file = strdup("/etc/lye/save");
+	config.seed = 0;
 	config.service_name = strdup("lye");
 	config.shutdown_cmd = strdup("/sbin/shutdown -a now");
 	config.shutdown_key = strdup("F1");
@@ -340,10 +373,15 @@ void lang_free() {
 }
 
 void config_free() {
+	free(config.art_file);
 	free(config.clock);
 	free(config.console_dev);
+	free(config.fb_device);
+	free(config.fb_geometry);
 	free(config.lang);
 	free(config.mcookie_cmd);
+	free(config.output_mode);
+	free(config.output_stats);
 	free(config.path);
 	free(config.restart_cmd);
 	free(config.restart_key);
@@ -61,6 +61,11 @@ struct lang {
 struct config {
 	bool animate;
 	uint8_t animation;
+	uint16_t animation_budget;
+	bool animation_idle;
+	bool animation_pressure;
+	uint8_t animation_threads;
+	char *art_file;
 	char asterisk;
 	uint8_t bg;
 	bool bigclock;
@@ -69,6 +74,8 @@ struct config {
 	char *clock;
 	char *console_dev;
 	uint8_t default_input;
+	char *fb_device;
+	char *fb_geometry;
 	uint8_t fg;
 	bool hide_borders;
 	bool hide_key_hints;
@@ -82,11 +89,16 @@ struct config {
 	uint8_t max_password_len;
 	char *mcookie_cmd;
 	uint16_t min_refresh_delta;
+	bool optimize_output;
+	uint16_t output_budget;
+	char *output_mode;
+	char *output_stats;
 	char *path;
 	char *restart_cmd;
 	char *restart_key;
 	bool save;
 	char *save_file;
+	uint32_t seed;
 	char *service_name;
 	char *shutdown_cmd;
 	char *shutdown_key;
@@ -4,14 +4,19 @@
 #include "termbox2.h"
 
 #include "animations.h"
+#include "arena.h"
 #include "bigclock.h"
+#include "blit.h"
+#include "clock.h"
+#include "colour.h"
+#include "compositor.h"
 #include "config.h"
 #include "draw.h"
 #include "inputs.h"
 #include "utils.h"
 
 #include <ctype.h>
-#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -28,23 +33,122 @@
 #include <linux/kd.h>
 #endif
 
-void draw_init(struct term_buf *buf) {
-	buf->width = tb_width();
-	buf->height = tb_height();
-	hostname(&buf->info_line);
+#define LOCK_STATE_INTERVAL 250
 
-	uint16_t len_login = strlen(lang.login);
-	uint16_t len_password = strlen(lang.password);
+#define BIGCLOCK_LEN 5
+#define BIGCLOCK_W (BIGCLOCK_LEN * (CLOCK_W + 1) - 1)
 
-	if(len_login > len_password) {
-		buf->labels_max_len = len_login;
-	} else {
-		buf->labels_max_len = len_password;
+// the configured text colours in the current output mode
+static uintattr_t text_fg;
+static uintattr_t text_bg;
+
+// the big clock glyphs (digits, ':' and ' ') with the configured colours
+static struct tb_cell clock_atlas[12][CLOCK_W * CLOCK_H];
+// the five glyphs of the current time, with transparent gaps between them
+static struct tb_cell clock_strip[CLOCK_H * BIGCLOCK_W];
+
+static void clock_atlas_init() {
+	const char glyphs[] = "0123456789: ";
+
+	for(int i = 0; i < 12; ++i) {
+		uint32_t *clockchars = CLOCK_N(glyphs[i]);
+
+		for(int k = 0; k < CLOCK_W * CLOCK_H; ++k) {
+			clock_atlas[i][k].ch = clockchars[k];
+			clock_atlas[i][k].fg = text_fg;
+			clock_atlas[i][k].bg = text_bg;
+		}
+	}
+}
+
+static const struct tb_cell *clock_glyph(char c) {
+	if(c >= '0' && c <= '9') {
+		return clock_atlas[c - '0'];
+	}
+
+	return c == ':' ? clock_atlas[10] : clock_atlas[11];
+}
+
+static void clock_strip_put(int slot, const struct tb_cell *glyph) {
+	for(int i = 0; i < CLOCK_H; ++i) {
+		memcpy(&clock_strip[i * BIGCLOCK_W + slot * (CLOCK_W + 1)],
+		       &glyph[i * CLOCK_W], sizeof(*glyph) * CLOCK_W);
+	}
+}
+
+// lays the widgets out for the terminal size and resizes the layers when it
+// changed, this clears them and everything cached from the previous size
+static void layout_apply(struct term_buf *buf) {
+	uint16_t width = tb_width();
+	uint16_t height = tb_height();
+
+	layout_compute(&buf->layout, width, height);
+	buf->width = width;
+	buf->height = height;
+
+	if(width == buf->comp.width && height == buf->comp.height) {
+		return;
+	}
+
+	compositor_resize(&buf->comp, width, height);
+
+	if(dgn_catch()) {
+		dgn_reset();
+	}
+
+	buf->static_dirty = true;
+	buf->occlusion.len = 0;
+	buf->bigclock_minute = -1;
+	buf->clock.valid = false;
+	buf->lock_state.valid = false;
+	buf->lock_state.next = 0;
+	memset(&buf->info_rect, 0, sizeof(buf->info_rect));
+	memset(&buf->clock_rect, 0, sizeof(buf->clock_rect));
+	memset(&buf->numlock_rect, 0, sizeof(buf->numlock_rect));
+	memset(&buf->capslock_rect, 0, sizeof(buf->capslock_rect));
+}
+
+// called once a burst of resizes settled, the animation state is sized for
+// the terminal so it is rebuilt along with the layers
+void draw_layout(struct term_buf *buf) // throws
+{
+	if(config.animate) {
+		render_wait(buf);
 	}
 
-	buf->box_height = 7 + (2 * config.margin_box_v);
-	buf->box_width = (2 * config.margin_box_h) + (config.input_len + 1) +
-	                 buf->labels_max_len;
+	layout_apply(buf);
+
+	if(config.animate) {
+		animation_resize(buf);
+	}
+}
+
+void draw_init(struct term_buf *buf) {
+	hostname(&buf->info_line);
+	tzset();
+	text_fg = colour_basic(config.fg);
+	text_bg = colour_basic(config.bg);
+	clock_atlas_init();
+	buf->bigclock_minute = -1;
+	buf->lock_state.valid = false;
+	buf->lock_state.failed = false;
+	buf->lock_state.next = 0;
+
+	if(config.clock != NULL) {
+		clock_cache_init(&buf->clock, config.clock);
+	}
+
+	art_open(&buf->art, config.art_file);
+	rng_instance(&buf->rng);
+	memset(&buf->render, 0, sizeof(buf->render));
+	buf->canvas = NULL;
+	buf->canvas_damage = NULL;
+
+	compositor_init(&buf->comp);
+	buf->occlusion.len = 0;
+	buf->static_dirty = true;
+	layout_init(&buf->layout, BIGCLOCK_W, CLOCK_H);
+	layout_apply(buf);
 
 #if defined(__linux__) || defined(__FreeBSD__)
 	buf->box_chars.left_up = 0x250c;
@@ -71,161 +175,227 @@ void draw_free(struct term_buf *buf) {
 	if(config.animate) {
 		animation_free(buf);
 	}
+
+	art_close(&buf->art);
+	compositor_free(&buf->comp);
+}
+
+// the box, labels and key hints only depend on the terminal size, the
+// language and the config, so they are rendered once into their own layer
+void draw_static(struct term_buf *buf) {
+	if(!buf->static_dirty) {
+		return;
+	}
+
+	draw_art(buf);
+	draw_box(buf);
+	draw_labels(buf);
+
+	if(!config.hide_key_hints) {
+		draw_key_hints(buf);
+	}
+
+	buf->static_dirty = false;
+}
+
+// recomposes the damaged parts of the screen into the termbox back buffer
+bool draw_compose(struct term_buf *buf) {
+	return compositor_compose(&buf->comp, tb_cell_buffer());
 }
 
 void draw_box(struct term_buf *buf) {
-	uint16_t box_x = (buf->width - buf->box_width) / 2;
-	uint16_t box_y = (buf->height - buf->box_height) / 2;
-	uint16_t box_x2 = (buf->width + buf->box_width) / 2;
-	uint16_t box_y2 = (buf->height + buf->box_height) / 2;
-	buf->box_x = box_x;
-	buf->box_y = box_y;
+	const struct layout *layout = &buf->layout;
+	int box_x = layout->box_x;
+	int box_y = layout->box_y;
+	int box_x2 = layout->box_x2;
+	int box_y2 = layout->box_y2;
+
+	struct compositor *comp = &buf->comp;
 
 	if(!config.hide_borders) {
+		struct tb_cell c = {buf->box_chars.left_up, text_fg, text_bg};
+
 		// corners
-		tb_change_cell(box_x - 1, box_y - 1, buf->box_chars.left_up, config.fg,
-		               config.bg);
-		tb_change_cell(box_x2, box_y - 1, buf->box_chars.right_up, config.fg,
-		               config.bg);
-		tb_change_cell(box_x - 1, box_y2, buf->box_chars.left_down, config.fg,
-		               config.bg);
-		tb_change_cell(box_x2, box_y2, buf->box_chars.right_down, config.fg,
-		               config.bg);
+		layer_put(comp, LAYER_STATIC, box_x - 1, box_y - 1, &c);
+		c.ch = buf->box_chars.right_up;
+		layer_put(comp, LAYER_STATIC, box_x2, box_y - 1, &c);
+		c.ch = buf->box_chars.left_down;
+		layer_put(comp, LAYER_STATIC, box_x - 1, box_y2, &c);
+		c.ch = buf->box_chars.right_down;
+		layer_put(comp, LAYER_STATIC, box_x2, box_y2, &c);
 
 		// top and bottom
-		struct tb_cell c1 = {buf->box_chars.top, config.fg, config.bg};
-		struct tb_cell c2 = {buf->box_chars.bot, config.fg, config.bg};
-
-		for(uint16_t i = 0; i < buf->box_width; ++i) {
-			tb_put_cell(box_x + i, box_y - 1, &c1);
-			tb_put_cell(box_x + i, box_y2, &c2);
-		}
+		c.ch = buf->box_chars.top;
+		layer_fill(comp, LAYER_STATIC, box_x, box_y - 1, layout->box_width, 1,
+		           &c);
+		c.ch = buf->box_chars.bot;
+		layer_fill(comp, LAYER_STATIC, box_x, box_y2, layout->box_width, 1, &c);
 
 		// left and right
-		c1.ch = buf->box_chars.left;
-		c2.ch = buf->box_chars.right;
-
-		for(uint16_t i = 0; i < buf->box_height; ++i) {
-			tb_put_cell(box_x - 1, box_y + i, &c1);
-
-			tb_put_cell(box_x2, box_y + i, &c2);
-		}
+		c.ch = buf->box_chars.left;
+		layer_fill(comp, LAYER_STATIC, box_x - 1, box_y, 1, layout->box_height,
+		           &c);
+		c.ch = buf->box_chars.right;
+		layer_fill(comp, LAYER_STATIC, box_x2, box_y, 1, layout->box_height,
+		           &c);
 	}
 
-	if(config.blank_box) {
-		struct tb_cell blank = {' ', config.fg, config.bg};
+	buf->occlusion.len = 0;
 
-		for(uint16_t i = 0; i < buf->box_height; ++i) {
-			for(uint16_t k = 0; k < buf->box_width; ++k) {
-				tb_put_cell(box_x + k, box_y + i, &blank);
-			}
+	if(config.blank_box) {
+		struct tb_cell blank = {' ', text_fg, text_bg};
+
+		layer_fill(comp, LAYER_STATIC, box_x, box_y, layout->box_width,
+		           layout->box_height, &blank);
+
+		// the animation does not have to draw under a solid box
+		int border = config.hide_borders ? 0 : 1;
+		int x = box_x - border;
+		int y = box_y - border;
+		int w = layout->box_width + 2 * border;
+		int h = layout->box_height + 2 * border;
+		int sx;
+		int sy;
+
+		if(blit_clip(buf->width, buf->height, &x, &y, &w, &h, &sx, &sy)) {
+			struct rect box = {x, y, w, h};
+			occlusion_add(&buf->occlusion, box);
 		}
 	}
 }
 
-char *time_str(char *fmt, int maxlen) {
-	time_t timer;
-	char *buffer = malloc(maxlen);
-	struct tm *tm_info;
-
-	timer = time(NULL);
-	tm_info = localtime(&timer);
+// the art is centred on the terminal, its transparent cells let the
+// animation show through
+void draw_art(struct term_buf *buf) {
+	const struct art *art = &buf->art;
 
-	if(strftime(buffer, maxlen, fmt, tm_info) == 0) {
-		buffer[0] = '\0';
+	if(art->cells == NULL) {
+		return;
 	}
 
-	return buffer;
+	int x = (buf->width - art->width) / 2;
+	int y = (buf->height - art->height) / 2;
+
+	layer_blit(&buf->comp, LAYER_ART, x, y, art->width, art->height,
+	           art->cells, true);
 }
 
-extern inline uint32_t *CLOCK_N(char c);
+void draw_bigclock(struct term_buf *buf) {
+	if(!config.bigclock || !buf->layout.bigclock_visible) {
+		return;
+	}
 
-struct tb_cell *clock_cell(char c) {
-	struct tb_cell *cells = malloc(sizeof(*cells) * CLOCK_W * CLOCK_H);
+	int xo = buf->layout.bigclock_x;
+	int yo = buf->layout.bigclock_y;
 
 	struct timeval tv;
 	gettimeofday(&tv, NULL);
-	if(config.animate && c == ':' && tv.tv_usec / 500000) {
-		c = ' ';
-	}
-	uint32_t *clockchars = CLOCK_N(c);
 
-	for(int i = 0; i < CLOCK_W * CLOCK_H; i++) {
-		cells[i].ch = clockchars[i];
-		cells[i].fg = config.fg;
-		cells[i].bg = config.bg;
-	}
+	// every timezone offset is a whole number of minutes
+	int64_t minute = tv.tv_sec / 60;
+	char colon = (config.animate && tv.tv_usec / 500000) ? ' ' : ':';
 
-	return cells;
-}
+	if(minute != buf->bigclock_minute) {
+		time_t timer = tv.tv_sec;
+		struct tm tm_info;
+		localtime_r(&timer, &tm_info);
 
-void alpha_blit(struct tb_cell *buf, uint16_t x, uint16_t y, uint16_t w,
-                uint16_t h, struct tb_cell *cells) {
-	if(x + w >= tb_width() || y + h >= tb_height())
-		return;
+		clock_strip_put(0, clock_glyph('0' + tm_info.tm_hour / 10));
+		clock_strip_put(1, clock_glyph('0' + tm_info.tm_hour % 10));
+		clock_strip_put(2, clock_glyph(colon));
+		clock_strip_put(3, clock_glyph('0' + tm_info.tm_min / 10));
+		clock_strip_put(4, clock_glyph('0' + tm_info.tm_min % 10));
 
-	for(int i = 0; i < h; i++) {
-		for(int j = 0; j < w; j++) {
-			struct tb_cell cell = cells[i * w + j];
-			if(cell.ch) {
-				buf[(y + i) * tb_width() + (x + j)] = cell;
-			}
-		}
+		// empty glyph cells are transparent, they are copied as well to
+		// erase the previous digits
+		layer_blit(&buf->comp, LAYER_BIGCLOCK, xo, yo, BIGCLOCK_W, CLOCK_H,
+		           clock_strip, false);
+
+		buf->bigclock_minute = minute;
+		buf->bigclock_colon = colon;
+	} else if(colon != buf->bigclock_colon) {
+		layer_blit(&buf->comp, LAYER_BIGCLOCK, xo + 2 * (CLOCK_W + 1), yo,
+		           CLOCK_W, CLOCK_H, clock_glyph(colon), false);
+
+		buf->bigclock_colon = colon;
 	}
 }
 
-void draw_bigclock(struct term_buf *buf) {
-	if(!config.bigclock) {
+void draw_clock(struct term_buf *buf) {
+	if(config.clock == NULL || strlen(config.clock) == 0) {
 		return;
 	}
 
-	int xo = buf->width / 2 - (5 * (CLOCK_W + 1)) / 2;
-	int yo = (buf->height - buf->box_height) / 2 - CLOCK_H - 2;
+	struct clock_cache *clock = &buf->clock;
 
-	char *clockstr = time_str("%H:%M", 6);
-	struct tb_cell *clockcell;
-
-	for(int i = 0; i < 5; i++) {
-		clockcell = clock_cell(clockstr[i]);
-		alpha_blit(tb_cell_buffer(), xo + i * (CLOCK_W + 1), yo, CLOCK_W,
-		           CLOCK_H, clockcell);
-		free(clockcell);
+	if(!clock_cache_update(clock, time(NULL))) {
+		return;
 	}
 
-	free(clockstr);
+	strn_cell_into(clock->cells, clock->text, clock->len);
+	layer_text(&buf->comp, LAYER_STATUS, &buf->clock_rect,
+	           buf->width - clock->len, 0, clock->cells, clock->len);
 }
 
-void draw_clock(struct term_buf *buf) {
-	if(config.clock == NULL || strlen(config.clock) == 0) {
-		return;
+// milliseconds until one of the clocks has to be redrawn, -1 if never
+int draw_timeout(struct term_buf *buf) {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	time_t next = (time_t)-1;
+
+	if(config.bigclock) {
+		next = clock_next(CLOCK_MINUTE, now.tv_sec);
+	}
+
+	if(config.clock != NULL && buf->clock.valid &&
+	   buf->clock.next != (time_t)-1 &&
+	   (next == (time_t)-1 || buf->clock.next < next)) {
+		next = buf->clock.next;
+	}
+
+	if(next == (time_t)-1) {
+		return -1;
 	}
 
-	char *clockstr = time_str(config.clock, 32);
-	int clockstrlen = strlen(clockstr);
+	int64_t timeout =
+		(int64_t)(next - now.tv_sec) * 1000 - now.tv_nsec / 1000000 + 1;
 
-	struct tb_cell *cells = strn_cell(clockstr, clockstrlen);
-	draw_cells(buf->width - clockstrlen, 0, clockstrlen, 1, cells);
+	if(timeout < 0) {
+		return 0;
+	}
 
-	free(clockstr);
-	free(cells);
+	return timeout > INT_MAX ? INT_MAX : timeout;
 }
 
-struct tb_cell *strn_cell(char *s, uint16_t len) // throws
-{
-	struct tb_cell *cells = malloc_or_throw((sizeof(*cells)) * len);
+void strn_cell_into(struct tb_cell *cells, char *s, uint16_t len) {
 	char *s2 = s;
 	uint32_t c;
 
 	for(uint16_t i = 0; i < len; ++i) {
+		// multi-byte characters leave transparent cells at the end, the
+		// arena memory is not zeroed
 		if((s2 - s) >= len) {
-			break;
+			cells[i].ch = 0;
+			cells[i].bg = text_bg;
+			cells[i].fg = text_fg;
+			continue;
 		}
 
 		s2 += tb_utf8_char_to_unicode(&c, s2);
 
 		cells[i].ch = c;
-		cells[i].bg = config.bg;
-		cells[i].fg = config.fg;
+		cells[i].bg = text_bg;
+		cells[i].fg = text_fg;
+	}
+}
+
+struct tb_cell *strn_cell(char *s, uint16_t len) // throws
+{
+	struct tb_cell *cells = arena_alloc(&frame_arena, (sizeof(*cells)) * len);
+
+	if(cells != NULL) {
+		strn_cell_into(cells, s, len);
 	}
 
 	return cells;
@@ -238,16 +408,16 @@ struct tb_cell *str_cell(char *s) // throws
 
 void draw_labels(struct term_buf *buf) // throws
 {
+	struct compositor *comp = &buf->comp;
+
 	// login text
 	struct tb_cell *login = str_cell(lang.login);
 
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(buf->box_x + config.margin_box_h,
-		        buf->box_y + config.margin_box_v + 4, strlen(lang.login), 1,
-		        login);
-		free(login);
+		layer_blit(comp, LAYER_STATIC, buf->layout.label_x,
+		           buf->layout.login_y, strlen(lang.login), 1, login, false);
 	}
 
 	// password text
@@ -256,11 +426,14 @@ void draw_labels(struct term_buf *buf) // throws
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(buf->box_x + config.margin_box_h,
-		        buf->box_y + config.margin_box_v + 6, strlen(lang.password), 1,
-		        password);
-		free(password);
+		layer_blit(comp, LAYER_STATIC, buf->layout.label_x,
+		           buf->layout.password_y, strlen(lang.password), 1, password,
+		           false);
 	}
+}
+
+void draw_info_line(struct term_buf *buf) {
+	struct compositor *comp = &buf->comp;
 
 	if(buf->info_line != NULL) {
 		uint16_t len = strlen(buf->info_line);
@@ -269,21 +442,24 @@ void draw_labels(struct term_buf *buf) // throws
 		if(dgn_catch()) {
 			dgn_reset();
 		} else {
-			draw_cells(buf->box_x + ((buf->box_width - len) / 2),
-			        buf->box_y + config.margin_box_v, len, 1, info_cell);
-			free(info_cell);
+			layer_text(comp, LAYER_WIDGETS, &buf->info_rect,
+			           buf->layout.box_x + ((buf->layout.box_width - len) / 2),
+			           buf->layout.info_y, info_cell, len);
 		}
+	} else {
+		layer_text(comp, LAYER_WIDGETS, &buf->info_rect, 0, 0, NULL, 0);
 	}
 }
 
-void draw_key_hints() {
+void draw_key_hints(struct term_buf *buf) {
+	struct compositor *comp = &buf->comp;
+
 	struct tb_cell *shutdown_key = str_cell(config.shutdown_key);
 	int len = strlen(config.shutdown_key);
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(0, 0, len, 1, shutdown_key);
-		free(shutdown_key);
+		layer_blit(comp, LAYER_STATIC, 0, 0, len, 1, shutdown_key, false);
 	}
 
 	struct tb_cell *shutdown = str_cell(lang.shutdown);
@@ -291,8 +467,8 @@ void draw_key_hints() {
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(len, 0, strlen(lang.shutdown), 1, shutdown);
-		free(shutdown);
+		layer_blit(comp, LAYER_STATIC, len, 0, strlen(lang.shutdown), 1,
+		           shutdown, false);
 	}
 
 	struct tb_cell *restart_key = str_cell(config.restart_key);
@@ -300,8 +476,8 @@ void draw_key_hints() {
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(len, 0, strlen(config.restart_key), 1, restart_key);
-		free(restart_key);
+		layer_blit(comp, LAYER_STATIC, len, 0, strlen(config.restart_key), 1,
+		           restart_key, false);
 	}
 
 	struct tb_cell *restart = str_cell(lang.restart);
@@ -309,56 +485,92 @@ void draw_key_hints() {
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(len, 0, strlen(lang.restart), 1, restart);
-		free(restart);
+		layer_blit(comp, LAYER_STATIC, len, 0, strlen(lang.restart), 1,
+		           restart, false);
 	}
 }
 
-void draw_lock_state(struct term_buf *buf) {
-	// get values
-	int fd = open(config.console_dev, O_RDONLY);
+// reads the keyboard leds, returns false if the console is unavailable
+static bool lock_state_read(bool *numlock_on, bool *capslock_on) {
+	int fd = console_open();
 
 	if(fd < 0) {
-		buf->info_line = lang.err_console_dev;
-		return;
+		return false;
 	}
 
-	bool numlock_on;
-	bool capslock_on;
-
 #if defined(__DragonFly__) || defined(__FreeBSD__)
 	int led;
 	ioctl(fd, KDGETLED, &led);
-	numlock_on = led & LED_NUM;
-	capslock_on = led & LED_CAP;
+	*numlock_on = led & LED_NUM;
+	*capslock_on = led & LED_CAP;
 #else // linux
 	char led;
 	ioctl(fd, KDGKBLED, &led);
-	numlock_on = led & K_NUMLOCK;
-	capslock_on = led & K_CAPSLOCK;
+	*numlock_on = led & K_NUMLOCK;
+	*capslock_on = led & K_CAPSLOCK;
 #endif
 
-	close(fd);
+	return true;
+}
 
-	// print text
-	uint16_t pos_x = buf->width - strlen(lang.numlock);
-	uint16_t pos_y = 1;
-	if(config.clock == NULL || strlen(config.clock) == 0) {
-		pos_y = 0;
+// the leds are sampled at most every LOCK_STATE_INTERVAL milliseconds, or
+// on the next frame after `lock_state.next` was reset by a key event, also
+// while the console can not be opened; the status line is only redrawn when
+// one of them flips
+void draw_lock_state(struct term_buf *buf) {
+	struct lock_state *state = &buf->lock_state;
+	uint64_t now = monotonic_ms();
+
+	if(now < state->next) {
+		return;
+	}
+
+	state->next = now + LOCK_STATE_INTERVAL;
+
+	bool numlock_on;
+	bool capslock_on;
+
+	// the error is shown once, an auth error shown later stays
+	if(!lock_state_read(&numlock_on, &capslock_on)) {
+		if(!state->failed) {
+			buf->info_line = lang.err_console_dev;
+		}
+
+		state->failed = true;
+		return;
 	}
 
+	state->failed = false;
+
+	if(state->valid && numlock_on == state->numlock_on &&
+	   capslock_on == state->capslock_on) {
+		return;
+	}
+
+	state->numlock_on = numlock_on;
+	state->capslock_on = capslock_on;
+	state->valid = true;
+
+	// print text
+	struct compositor *comp = &buf->comp;
+	uint16_t pos_x = buf->layout.numlock_x;
+	uint16_t pos_y = buf->layout.lock_y;
+
 	if(numlock_on) {
 		struct tb_cell *numlock = str_cell(lang.numlock);
 
 		if(dgn_catch()) {
 			dgn_reset();
 		} else {
-			draw_cells(pos_x, pos_y, strlen(lang.numlock), 1, numlock);
-			free(numlock);
+			layer_text(comp, LAYER_STATUS, &buf->numlock_rect, pos_x, pos_y,
+			           numlock, strlen(lang.numlock));
 		}
+	} else {
+		layer_text(comp, LAYER_STATUS, &buf->numlock_rect, pos_x, pos_y, NULL,
+		           0);
 	}
 
-	pos_x -= strlen(lang.capslock) + 1;
+	pos_x = buf->layout.capslock_x;
 
 	if(capslock_on) {
 		struct tb_cell *capslock = str_cell(lang.capslock);
@@ -366,95 +578,109 @@ void draw_lock_state(struct term_buf *buf) {
 		if(dgn_catch()) {
 			dgn_reset();
 		} else {
-			draw_cells(pos_x, pos_y, strlen(lang.capslock), 1, capslock);
-			free(capslock);
+			layer_text(comp, LAYER_STATUS, &buf->capslock_rect, pos_x, pos_y,
+			           capslock, strlen(lang.capslock));
 		}
+	} else {
+		layer_text(comp, LAYER_STATUS, &buf->capslock_rect, pos_x, pos_y, NULL,
+		           0);
 	}
 }
 
-void draw_desktop(struct desktop *target) {
+void draw_desktop(struct term_buf *buf, struct desktop *target) {
+	struct compositor *comp = &buf->comp;
 	uint16_t len = strlen(target->list[target->cur]);
 
 	if(len > (target->visible_len - 3)) {
 		len = target->visible_len - 3;
 	}
 
-	tb_change_cell(target->x, target->y, '<', config.fg, config.bg);
+	// the whole field is rewritten so that a shorter name erases the
+	// previous one
+	const struct tb_cell clear = {0};
+	struct tb_cell c = {'<', text_fg, text_bg};
 
-	tb_change_cell(target->x + target->visible_len - 1, target->y, '>',
-	               config.fg, config.bg);
+	layer_put(comp, LAYER_WIDGETS, target->x, target->y, &c);
+	layer_put(comp, LAYER_WIDGETS, target->x + 1, target->y, &clear);
 
 	for(uint16_t i = 0; i < len; ++i) {
-		tb_change_cell(target->x + i + 2, target->y,
-		               target->list[target->cur][i], config.fg, config.bg);
+		c.ch = target->list[target->cur][i];
+		layer_put(comp, LAYER_WIDGETS, target->x + i + 2, target->y, &c);
 	}
+
+	layer_fill(comp, LAYER_WIDGETS, target->x + len + 2, target->y,
+	           target->visible_len - 3 - len, 1, &clear);
+
+	c.ch = '>';
+	layer_put(comp, LAYER_WIDGETS, target->x + target->visible_len - 1,
+	          target->y, &c);
 }
 
-void draw_input(struct text *input) {
+void draw_input(struct term_buf *buf, struct text *input) {
 	uint16_t len = strlen(input->text);
 	uint16_t visible_len = input->visible_len;
+	uint16_t text_len = input->end - input->visible_start;
 
 	if(len > visible_len) {
 		len = visible_len;
 	}
 
+	if(len > text_len) {
+		len = text_len;
+	}
+
 	struct tb_cell *cells = strn_cell(input->visible_start, len);
 
 	if(dgn_catch()) {
 		dgn_reset();
 	} else {
-		draw_cells(input->x, input->y, len, 1, cells);
-		free(cells);
+		layer_blit(&buf->comp, LAYER_WIDGETS, input->x, input->y, len, 1,
+		           cells, false);
 
-		struct tb_cell c1 = {' ', config.fg, config.bg};
+		if(text_len < visible_len) {
+			struct tb_cell c1 = {' ', text_fg, text_bg};
 
-		for(uint16_t i = input->end - input->visible_start; i < visible_len;
-		    ++i) {
-			tb_put_cell(input->x + i, input->y, &c1);
+			layer_fill(&buf->comp, LAYER_WIDGETS, input->x + text_len,
+			           input->y, visible_len - text_len, 1, &c1);
 		}
 	}
 }
 
-void draw_input_mask(struct text *input) {
-	uint16_t len = strlen(input->text);
+void draw_input_mask(struct term_buf *buf, struct text *input) {
 	uint16_t visible_len = input->visible_len;
+	uint16_t len = input->end - input->visible_start;
 
 	if(len > visible_len) {
 		len = visible_len;
 	}
 
-	struct tb_cell c1 = {config.asterisk, config.fg, config.bg};
-	struct tb_cell c2 = {' ', config.fg, config.bg};
+	struct tb_cell c1 = {config.asterisk, text_fg, text_bg};
+	struct tb_cell c2 = {' ', text_fg, text_bg};
 
-	for(uint16_t i = 0; i < visible_len; ++i) {
-		if(input->visible_start + i < input->end) {
-			tb_put_cell(input->x + i, input->y, &c1);
-		} else {
-			tb_put_cell(input->x + i, input->y, &c2);
-		}
-	}
+	layer_fill(&buf->comp, LAYER_WIDGETS, input->x, input->y, len, 1, &c1);
+	layer_fill(&buf->comp, LAYER_WIDGETS, input->x + len, input->y,
+	           visible_len - len, 1, &c2);
 }
 
 void position_input(struct term_buf *buf, struct desktop *desktop,
                     struct text *login, struct text *password) {
-	uint16_t x = buf->box_x + config.margin_box_h + buf->labels_max_len + 1;
-	int32_t len = buf->box_x + buf->box_width - config.margin_box_h - x;
+	const struct layout *layout = &buf->layout;
 
-	if(len < 0) {
+	if(!layout->inputs_visible) {
 		return;
 	}
 
-	desktop->x = x;
-	desktop->y = buf->box_y + config.margin_box_v + 2;
-	desktop->visible_len = len;
+	desktop->x = layout->input_x;
+	desktop->y = layout->desktop_y;
+	desktop->visible_len = layout->input_len;
 
-	login->x = x;
-	login->y = buf->box_y + config.margin_box_v + 4;
-	login->visible_len = len;
+	login->x = layout->input_x;
+	login->y = layout->login_y;
+	login->visible_len = layout->input_len;
 
-	password->x = x;
-	password->y = buf->box_y + config.margin_box_v + 6;
-	password->visible_len = len;
+	password->x = layout->input_x;
+	password->y = layout->password_y;
+	password->visible_len = layout->input_len;
 }
 
 bool cascade(struct term_buf *term_buf, uint8_t *fails) {
@@ -484,7 +710,7 @@ bool cascade(struct term_buf *term_buf, uint8_t *fails) {
 				changes = true;
 			}
 
-			if((rand() % 10) > 7) {
+			if(rng_below(&term_buf->rng, 10) > 7) {
 				continue;
 			}
 
@@ -1,7 +1,14 @@
 #ifndef H_LYE_DRAW
 #define H_LYE_DRAW
 
+#include "animations/utils/rng.h"
+#include "art.h"
+#include "clock.h"
+#include "compositor.h"
+#include "governor.h"
 #include "inputs.h"
+#include "layout.h"
+#include "render.h"
 #include "termbox2.h"
 
 #include <stdbool.h>
@@ -18,6 +25,15 @@ struct box {
 	uint32_t right;
 };
 
+struct lock_state {
+	bool numlock_on;
+	bool capslock_on;
+	bool valid;
+	// the console could not be opened on the last try
+	bool failed;
+	uint64_t next;
+};
+
 struct term_buf {
 	uint16_t width;
 	uint16_t height;
@@ -26,28 +42,55 @@ struct term_buf {
 
 	struct box box_chars;
 	char *info_line;
-	uint16_t labels_max_len;
-	uint16_t box_x;
-	uint16_t box_y;
-	uint16_t box_width;
-	uint16_t box_height;
+	struct layout layout;
+
+	struct compositor comp;
+	struct occlusion occlusion;
+	bool static_dirty;
+	int64_t bigclock_minute;
+	char bigclock_colon;
+	struct clock_cache clock;
+	struct lock_state lock_state;
+	struct rect info_rect;
+	struct rect clock_rect;
+	struct rect numlock_rect;
+	struct rect capslock_rect;
+
+	struct art art;
+	struct rng rng;
 
+	// the animation draws into `canvas`, the buffer of the render thread,
+	// and adds what it changed to the span of every row in `canvas_damage`
 	void *animation_state;
+	struct tb_cell *canvas;
+	struct span *canvas_damage;
+	struct render render;
+	struct governor governor;
+	uint8_t animation;
+	uint64_t animation_time;
+	uint64_t animation_due;
+	uint16_t animation_tick;
 };
 
 void draw_init(struct term_buf *buf);
 void draw_free(struct term_buf *buf);
+void draw_layout(struct term_buf *buf); // throws
+bool draw_compose(struct term_buf *buf);
+void draw_static(struct term_buf *buf);
 void draw_box(struct term_buf *buf);
+void draw_art(struct term_buf *buf);
 
+void strn_cell_into(struct tb_cell *cells, char *s, uint16_t len);
 struct tb_cell *strn_cell(char *s, uint16_t len);
 struct tb_cell *str_cell(char *s);
 
 void draw_labels(struct term_buf *buf);
-void draw_key_hints();
+void draw_info_line(struct term_buf *buf);
+void draw_key_hints(struct term_buf *buf);
 void draw_lock_state(struct term_buf *buf);
-void draw_desktop(struct desktop *target);
-void draw_input(struct text *input);
-void draw_input_mask(struct text *input);
+void draw_desktop(struct term_buf *buf, struct desktop *target);
+void draw_input(struct term_buf *buf, struct text *input);
+void draw_input_mask(struct term_buf *buf, struct text *input);
 
 void position_input(struct term_buf *buf, struct desktop *desktop,
                     struct text *login, struct text *password);
@@ -56,5 +99,6 @@ bool cascade(struct term_buf *buf, uint8_t *fails);
 
 void draw_bigclock(struct term_buf *buf);
 void draw_clock(struct term_buf *buf);
+int draw_timeout(struct term_buf *buf);
 
 #endif
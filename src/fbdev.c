@@ -0,0 +1,402 @@
+#include "fbdev.h"
+#include "colour.h"
+#include "fbfont.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/fb.h>
+#include <linux/kd.h>
+#endif
+
+// glyphs are drawn at twice their height, one pixel away from the cell edge
+#define GLYPH_X 1
+#define GLYPH_Y 1
+
+struct channel {
+	uint8_t offset;
+	uint8_t length;
+};
+
+// mapped target, either a framebuffer device or a plain file laid out the
+// same way
+static int fb_fd = -1;
+static uint8_t *fb_mem = NULL;
+static size_t fb_size = 0;
+static uint32_t fb_width = 0;
+static uint32_t fb_height = 0;
+static uint32_t fb_stride = 0;
+static uint8_t fb_bytes = 0;
+static struct channel fb_red;
+static struct channel fb_green;
+static struct channel fb_blue;
+static uint32_t fb_default_fg;
+static uint32_t fb_default_bg;
+
+// only a real framebuffer has a console drawing over it
+static bool fb_device = false;
+static bool fb_graphics = false;
+
+// cells currently drawn, and the cell holding the cursor
+static struct tb_cell *front = NULL;
+static uint16_t front_width = 0;
+static uint16_t front_height = 0;
+static bool front_valid = false;
+static int drawn_cursor_x = -1;
+static int drawn_cursor_y = -1;
+
+static uint32_t pack(const uint8_t rgb[3]) {
+	return ((uint32_t)(rgb[0] >> (8 - fb_red.length)) << fb_red.offset) |
+	       ((uint32_t)(rgb[1] >> (8 - fb_green.length)) << fb_green.offset) |
+	       ((uint32_t)(rgb[2] >> (8 - fb_blue.length)) << fb_blue.offset);
+}
+
+static bool layout_device(int fd) {
+#if defined(__linux__)
+	struct fb_var_screeninfo var;
+	struct fb_fix_screeninfo fix;
+
+	if(ioctl(fd, FBIOGET_VSCREENINFO, &var) < 0 ||
+	   ioctl(fd, FBIOGET_FSCREENINFO, &fix) < 0) {
+		return false;
+	}
+
+	fb_width = var.xres;
+	fb_height = var.yres;
+	fb_stride = fix.line_length;
+	fb_bytes = var.bits_per_pixel / 8;
+	fb_size = fix.smem_len;
+	fb_red = (struct channel){var.red.offset, var.red.length};
+	fb_green = (struct channel){var.green.offset, var.green.length};
+	fb_blue = (struct channel){var.blue.offset, var.blue.length};
+
+	return true;
+#else
+	UNUSED(fd);
+	return false;
+#endif
+}
+
+// plain files use 32 bit xrgb pixels and the size given as `WxH`
+static bool layout_file(int fd, const char *geometry) {
+	unsigned width;
+	unsigned height;
+
+	if(geometry == NULL || sscanf(geometry, "%ux%u", &width, &height) != 2 ||
+	   width == 0 || height == 0) {
+		return false;
+	}
+
+	fb_width = width;
+	fb_height = height;
+	fb_bytes = 4;
+	fb_stride = width * 4;
+	fb_size = (size_t)fb_stride * height;
+	fb_red = (struct channel){16, 8};
+	fb_green = (struct channel){8, 8};
+	fb_blue = (struct channel){0, 8};
+
+	return ftruncate(fd, fb_size) == 0;
+}
+
+// maps the target, returns false when it can not be used so that the
+// terminal output is kept; a missing target is never created, a device
+// which went away would otherwise be replaced by a file nobody looks at
+bool fbdev_open(const char *path, const char *geometry) {
+	if(path == NULL || strlen(path) == 0) {
+		return false;
+	}
+
+	int fd = open(path, O_RDWR | O_CLOEXEC);
+	struct stat st;
+
+	if(fd < 0) {
+		return false;
+	}
+
+	if(fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+
+	// a character device has to be a framebuffer, only a regular file is
+	// laid out by the geometry
+	bool usable;
+	fb_device = S_ISCHR(st.st_mode);
+
+	if(fb_device) {
+		usable = layout_device(fd);
+	} else {
+		usable = S_ISREG(st.st_mode) && layout_file(fd, geometry);
+	}
+
+	if(!usable || (fb_bytes != 2 && fb_bytes != 4) ||
+	   (size_t)fb_stride * fb_height > fb_size) {
+		close(fd);
+		return false;
+	}
+
+	void *mem = mmap(NULL, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if(mem == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	fb_fd = fd;
+	fb_mem = mem;
+
+	const uint8_t grey[3] = {170, 170, 170};
+	const uint8_t black[3] = {0, 0, 0};
+	fb_default_fg = pack(grey);
+	fb_default_bg = pack(black);
+
+	front_valid = false;
+
+	return true;
+}
+
+void fbdev_close() {
+	if(fb_mem == NULL) {
+		return;
+	}
+
+	fbdev_suspend();
+	munmap(fb_mem, fb_size);
+	close(fb_fd);
+	free(front);
+
+	fb_mem = NULL;
+	fb_fd = -1;
+	front = NULL;
+	front_width = 0;
+	front_height = 0;
+}
+
+bool fbdev_active() {
+	return fb_mem != NULL;
+}
+
+void fbdev_invalidate() {
+	front_valid = false;
+}
+
+// gives the console back, for the session or before lye exits
+void fbdev_suspend() {
+#if defined(__linux__)
+	if(fb_graphics) {
+		int ttyfd;
+		int resizefd;
+
+		if(tb_get_fds(&ttyfd, &resizefd) == TB_OK) {
+			ioctl(ttyfd, KDSETMODE, KD_TEXT);
+		}
+	}
+#endif
+
+	fb_graphics = false;
+	front_valid = false;
+}
+
+static void take_console() {
+#if defined(__linux__)
+	int ttyfd;
+	int resizefd;
+
+	// the console would otherwise keep drawing its own text and cursor
+	if(fb_device && !fb_graphics && tb_get_fds(&ttyfd, &resizefd) == TB_OK &&
+	   ioctl(ttyfd, KDSETMODE, KD_GRAPHICS) == 0) {
+		fb_graphics = true;
+	}
+#endif
+}
+
+// eight pixels of a cell row, the leftmost one in the highest bit
+static uint8_t glyph_row(uint32_t ch, int row) {
+	bool mid = row == FB_CELL_H / 2 - 1 || row == FB_CELL_H / 2;
+	bool above = row < FB_CELL_H / 2 - 1;
+	bool below = row > FB_CELL_H / 2;
+
+	switch(ch) {
+		case 0x2500: // horizontal line
+			return mid ? 0xff : 0x00;
+		case 0x2502: // vertical line
+			return 0x18;
+		case 0x250c: // corners
+			return mid ? 0x1f : below ? 0x18 : 0x00;
+		case 0x2510:
+			return mid ? 0xf8 : below ? 0x18 : 0x00;
+		case 0x2514:
+			return mid ? 0x1f : above ? 0x18 : 0x00;
+		case 0x2518:
+			return mid ? 0xf8 : above ? 0x18 : 0x00;
+		case 0x2588: // shades
+			return 0xff;
+		case 0x2591:
+			return (row & 1) ? 0x22 : 0x88;
+		case 0x2592:
+			return (row & 1) ? 0x55 : 0xaa;
+		case 0x2593:
+			return (row & 1) ? 0xdd : 0x77;
+		default:
+			break;
+	}
+
+	if(ch < 0x20 || ch > 0x7e) {
+		ch = ch == 0 ? ' ' : '?';
+	}
+
+	int font_row = (row - GLYPH_Y) / 2;
+
+	if(row < GLYPH_Y || font_row >= FB_FONT_H) {
+		return 0x00;
+	}
+
+	return FB_FONT[ch - 0x20][font_row] << (8 - FB_FONT_W - GLYPH_X);
+}
+
+static uint32_t pixel(uintattr_t colour, uint32_t fallback) {
+	uint8_t rgb[3];
+
+	return colour_to_rgb(colour, rgb) ? pack(rgb) : fallback;
+}
+
+static void draw_cell(int x, int y, const struct tb_cell *cell, bool cursor) {
+	uint32_t px = (uint32_t)x * FB_CELL_W;
+	uint32_t py = (uint32_t)y * FB_CELL_H;
+
+	// cells which do not fit entirely are left out
+	if(px + FB_CELL_W > fb_width || py + FB_CELL_H > fb_height) {
+		return;
+	}
+
+	uintattr_t fg_attr = cell->fg;
+
+	// bold is shown as bright, like the vga console does
+	if((fg_attr & TB_BOLD) && colour_mode() == TB_OUTPUT_NORMAL) {
+		fg_attr |= TB_BRIGHT;
+	}
+
+	uint32_t fg = pixel(fg_attr, fb_default_fg);
+	uint32_t bg = pixel(cell->bg, fb_default_bg);
+
+	if((cell->fg & TB_REVERSE) || (cell->bg & TB_REVERSE)) {
+		uint32_t tmp = fg;
+		fg = bg;
+		bg = tmp;
+	}
+
+	for(int row = 0; row < FB_CELL_H; ++row) {
+		uint8_t mask = glyph_row(cell->ch, row);
+
+		if((cursor && row >= FB_CELL_H - 2) ||
+		   ((cell->fg & TB_UNDERLINE) && row == FB_CELL_H - 1)) {
+			mask = 0xff;
+		}
+
+		uint8_t *line = fb_mem + (size_t)(py + row) * fb_stride +
+		                (size_t)px * fb_bytes;
+
+		if(fb_bytes == 4) {
+			uint32_t *pixels = (uint32_t *)line;
+
+			for(int i = 0; i < FB_CELL_W; ++i) {
+				pixels[i] = (mask & (0x80 >> i)) ? fg : bg;
+			}
+		} else {
+			uint16_t *pixels = (uint16_t *)line;
+
+			for(int i = 0; i < FB_CELL_W; ++i) {
+				pixels[i] = (mask & (0x80 >> i)) ? fg : bg;
+			}
+		}
+	}
+}
+
+static bool cell_eq(const struct tb_cell *a, const struct tb_cell *b) {
+	return (a->ch == b->ch) && (a->fg == b->fg) && (a->bg == b->bg);
+}
+
+static void front_resize(uint16_t width, uint16_t height) // throws
+{
+	free(front);
+	front_width = 0;
+	front_height = 0;
+	front = malloc_or_throw(sizeof(*front) * width * height); // NOLINT
+
+	if(front == NULL) {
+		return;
+	}
+
+	front_width = width;
+	front_height = height;
+	front_valid = false;
+}
+
+// draws the cells which changed since the previous frame, plus the cells
+// the cursor left and entered
+void fbdev_frame(const struct tb_cell *cells, uint16_t width, uint16_t height,
+                 int cursor_x, int cursor_y) // throws
+{
+	if(fb_mem == NULL || cells == NULL) {
+		return;
+	}
+
+	if(width != front_width || height != front_height) {
+		front_resize(width, height);
+
+		if(front == NULL) {
+			return;
+		}
+	}
+
+	take_console();
+
+	if(!front_valid) {
+		// the default background is black in the palette
+		memset(fb_mem, 0, (size_t)fb_stride * fb_height);
+
+		for(size_t i = 0; i < (size_t)width * height; ++i) {
+			front[i] = (struct tb_cell){' ', TB_DEFAULT, TB_DEFAULT};
+		}
+
+		drawn_cursor_x = -1;
+		drawn_cursor_y = -1;
+		front_valid = true;
+	}
+
+	bool cursor_moved =
+		cursor_x != drawn_cursor_x || cursor_y != drawn_cursor_y;
+
+	for(uint16_t y = 0; y < height; ++y) {
+		const struct tb_cell *row = cells + (size_t)y * width;
+		struct tb_cell *front_row = front + (size_t)y * width;
+
+		for(uint16_t x = 0; x < width; ++x) {
+			bool at_cursor = x == cursor_x && y == cursor_y;
+			bool cursor_cell =
+				cursor_moved && (at_cursor || (x == drawn_cursor_x &&
+				                               y == drawn_cursor_y));
+
+			if(cell_eq(&front_row[x], &row[x]) && !cursor_cell) {
+				continue;
+			}
+
+			draw_cell(x, y, &row[x], at_cursor);
+			front_row[x] = row[x];
+		}
+	}
+
+	drawn_cursor_x = cursor_x;
+	drawn_cursor_y = cursor_y;
+}
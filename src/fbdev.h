@@ -0,0 +1,20 @@
+#ifndef H_LYE_FBDEV
+#define H_LYE_FBDEV
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FB_CELL_W 8
+#define FB_CELL_H 16
+
+bool fbdev_open(const char *path, const char *geometry);
+void fbdev_close();
+bool fbdev_active();
+void fbdev_invalidate();
+void fbdev_suspend();
+void fbdev_frame(const struct tb_cell *cells, uint16_t width, uint16_t height,
+                 int cursor_x, int cursor_y); // throws
+
+#endif
@@ -0,0 +1,79 @@
+#include "governor.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// frames over budget in a row before the resolution is lowered
+#define GOVERNOR_STRIKES 8
+// frames with room in a row before it is raised again
+#define GOVERNOR_CALM 32
+
+static const uint8_t scale_x[GOVERNOR_LEVELS] = {1, 2, 2};
+static const uint8_t scale_y[GOVERNOR_LEVELS] = {1, 1, 2};
+
+// a budget of 0 keeps the full resolution
+void governor_init(struct governor *gov, uint16_t budget_ms) {
+	gov->budget_us = (uint32_t)budget_ms * 1000;
+	gov->average_us = 0;
+	gov->level = 0;
+	gov->strikes = 0;
+	gov->calm = 0;
+}
+
+// takes the time a frame which changed something took, returns true when
+// the animation has to be rebuilt for another level
+bool governor_sample(struct governor *gov, uint32_t cost_us) {
+	if(gov->budget_us == 0) {
+		return false;
+	}
+
+	if(gov->average_us == 0) {
+		gov->average_us = cost_us;
+	} else {
+		gov->average_us = (3 * (uint64_t)gov->average_us + cost_us) / 4;
+	}
+
+	if(gov->average_us > gov->budget_us) {
+		gov->calm = 0;
+
+		if(gov->level + 1 >= GOVERNOR_LEVELS) {
+			return false;
+		}
+
+		if(++gov->strikes < GOVERNOR_STRIKES) {
+			return false;
+		}
+
+		++gov->level;
+	} else {
+		gov->strikes = 0;
+
+		// every level halves the cells, the level above costs about twice
+		// as much and has to fit with some room to spare
+		if(gov->level == 0 ||
+		   2 * (uint64_t)gov->average_us > gov->budget_us * 3 / 4) {
+			gov->calm = 0;
+			return false;
+		}
+
+		if(++gov->calm < GOVERNOR_CALM) {
+			return false;
+		}
+
+		--gov->level;
+	}
+
+	gov->average_us = 0;
+	gov->strikes = 0;
+	gov->calm = 0;
+
+	return true;
+}
+
+uint8_t governor_scale_x(const struct governor *gov) {
+	return scale_x[gov->level];
+}
+
+uint8_t governor_scale_y(const struct governor *gov) {
+	return scale_y[gov->level];
+}
@@ -0,0 +1,33 @@
+#ifndef H_LYE_GOVERNOR
+#define H_LYE_GOVERNOR
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct term_buf;
+
+// the animation is simulated at full resolution, at half the width or at
+// half the width and height, and scaled up into the canvas
+#define GOVERNOR_LEVELS 3
+
+// keeps the time an animation frame takes within the budget by lowering
+// the resolution the animation is simulated at, and raises it again once
+// there is room
+struct governor {
+	uint32_t budget_us;
+	uint32_t average_us;
+	uint8_t level;
+	uint8_t strikes;
+	uint8_t calm;
+
+	// what the animation draws into below full resolution, only its size
+	// and canvas are used
+	struct term_buf *view;
+};
+
+void governor_init(struct governor *gov, uint16_t budget_ms);
+bool governor_sample(struct governor *gov, uint32_t cost_us);
+uint8_t governor_scale_x(const struct governor *gov);
+uint8_t governor_scale_y(const struct governor *gov);
+
+#endif
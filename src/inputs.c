@@ -1,6 +1,7 @@
 #include "inputs.h"
 #include "config.h"
 #include "dragonfail.h"
+#include "present.h"
 #include "termbox2.h"
 #include "utils.h"
 
@@ -22,7 +23,7 @@ void handle_desktop(void *input_struct, struct tb_event *event) {
 		}
 	}
 
-	tb_set_cursor(target->x + 2, target->y);
+	present_cursor(target->x + 2, target->y);
 }
 
 void handle_text(void *input_struct, struct tb_event *event) {
@@ -52,7 +53,7 @@ void handle_text(void *input_struct, struct tb_event *event) {
 		}
 	}
 
-	tb_set_cursor(target->x + (target->cur - target->visible_start), target->y);
+	present_cursor(target->x + (target->cur - target->visible_start), target->y);
 }
 
 void input_desktop(struct desktop *target) {
@@ -0,0 +1,92 @@
+#include "layout.h"
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// the parts which only depend on the config and the language
+void layout_init(struct layout *layout, uint16_t bigclock_w,
+                 uint16_t bigclock_h) {
+	memset(layout, 0, sizeof(*layout));
+
+	uint16_t len_login = strlen(lang.login);
+	uint16_t len_password = strlen(lang.password);
+
+	if(len_login > len_password) {
+		layout->labels_max_len = len_login;
+	} else {
+		layout->labels_max_len = len_password;
+	}
+
+	layout->box_width = (2 * config.margin_box_h) + (config.input_len + 1) +
+	                    layout->labels_max_len;
+	layout->box_height = 7 + (2 * config.margin_box_v);
+	layout->bigclock_w = bigclock_w;
+	layout->bigclock_h = bigclock_h;
+}
+
+void layout_compute(struct layout *layout, uint16_t width, uint16_t height) {
+	layout->width = width;
+	layout->height = height;
+	layout->pending = false;
+
+	// box
+	layout->box_x = (width - layout->box_width) / 2;
+	layout->box_y = (height - layout->box_height) / 2;
+	layout->box_x2 = (width + layout->box_width) / 2;
+	layout->box_y2 = (height + layout->box_height) / 2;
+	layout->label_x = layout->box_x + config.margin_box_h;
+	layout->info_y = layout->box_y + config.margin_box_v;
+
+	// inputs
+	int input_x = layout->label_x + layout->labels_max_len + 1;
+	int input_len = layout->box_x + layout->box_width - config.margin_box_h -
+	                input_x;
+
+	layout->inputs_visible = input_len >= 0;
+	layout->input_x = input_x;
+	layout->input_len = input_len >= 0 ? input_len : 0;
+	layout->desktop_y = layout->box_y + config.margin_box_v + 2;
+	layout->login_y = layout->box_y + config.margin_box_v + 4;
+	layout->password_y = layout->box_y + config.margin_box_v + 6;
+
+	// the big clock is only shown when it fits entirely
+	int xo = width / 2 - (layout->bigclock_w + 1) / 2;
+	int yo = (height - layout->box_height) / 2 - layout->bigclock_h - 2;
+
+	layout->bigclock_visible = xo >= 0 && yo >= 0 &&
+	                           xo + layout->bigclock_w < width &&
+	                           yo + layout->bigclock_h < height;
+	layout->bigclock_x = layout->bigclock_visible ? xo : 0;
+	layout->bigclock_y = layout->bigclock_visible ? yo : 0;
+
+	// lock state, below the clock when there is one
+	layout->numlock_x = width - strlen(lang.numlock);
+	layout->capslock_x = layout->numlock_x - strlen(lang.capslock) - 1;
+	layout->lock_y = 1;
+
+	if(config.clock == NULL || strlen(config.clock) == 0) {
+		layout->lock_y = 0;
+	}
+}
+
+// consoles can send dozens of resizes in a row, for instance while a remote
+// display reconnects, so each one only pushes the layout further back
+void layout_resized(struct layout *layout, uint64_t now) {
+	layout->pending = true;
+	layout->settle_at = now + LAYOUT_SETTLE_MS;
+}
+
+bool layout_due(const struct layout *layout, uint64_t now) {
+	return layout->pending && now >= layout->settle_at;
+}
+
+// milliseconds until a pending resize is due, -1 if there is none
+int layout_timeout(const struct layout *layout, uint64_t now) {
+	if(!layout->pending) {
+		return -1;
+	}
+
+	return now >= layout->settle_at ? 0 : (int)(layout->settle_at - now);
+}
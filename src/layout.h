@@ -0,0 +1,58 @@
+#ifndef H_LYE_LAYOUT
+#define H_LYE_LAYOUT
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// resize events closer together than this are laid out only once
+#define LAYOUT_SETTLE_MS 150
+
+// where every widget goes for one terminal size, so that frames only read
+// the geometry instead of working it out again
+struct layout {
+	uint16_t width;
+	uint16_t height;
+
+	// the inside of the box, its borders go one cell further out
+	int box_x;
+	int box_y;
+	int box_x2;
+	int box_y2;
+	uint16_t box_width;
+	uint16_t box_height;
+
+	uint16_t labels_max_len;
+	uint16_t label_x;
+	uint16_t info_y;
+
+	// the three inputs share their column and length
+	bool inputs_visible;
+	uint16_t input_x;
+	uint16_t input_len;
+	uint16_t desktop_y;
+	uint16_t login_y;
+	uint16_t password_y;
+
+	bool bigclock_visible;
+	uint16_t bigclock_w;
+	uint16_t bigclock_h;
+	uint16_t bigclock_x;
+	uint16_t bigclock_y;
+
+	uint16_t numlock_x;
+	uint16_t capslock_x;
+	uint16_t lock_y;
+
+	// a resize which is not laid out yet
+	bool pending;
+	uint64_t settle_at;
+};
+
+void layout_init(struct layout *layout, uint16_t bigclock_w,
+                 uint16_t bigclock_h);
+void layout_compute(struct layout *layout, uint16_t width, uint16_t height);
+void layout_resized(struct layout *layout, uint64_t now);
+bool layout_due(const struct layout *layout, uint64_t now);
+int layout_timeout(const struct layout *layout, uint64_t now);
+
+#endif
@@ -4,10 +4,17 @@
 #include "termbox2.h"
 
 #include "animations.h"
+#include "animations/utils/rng.h"
+#include "arena.h"
+#include "colour.h"
 #include "config.h"
 #include "draw.h"
 #include "inputs.h"
+#include "layout.h"
 #include "login.h"
+#include "pool.h"
+#include "present.h"
+#include "throttle.h"
 #include "utils.h"
 
 #include <stdbool.h>
@@ -20,6 +27,7 @@
 #include <unistd.h>
 
 #define ARG_COUNT 7
+#define FRAME_ARENA_SIZE 4096
 
 #ifndef LYE_VERSION
 #define LYE_VERSION "0.6.0"
@@ -28,6 +36,7 @@
 // global
 struct lang lang;
 struct config config;
+struct arena frame_arena;
 
 // args handles
 void arg_help(void *data, char **pars, const int pars_count) {
@@ -67,11 +76,6 @@ void arg_config(void *data, char **pars, const int pars_count) {
 
 // lye!
 int main(int argc, char **argv) {
-	// seed random number generator
-	struct timeval t;
-	gettimeofday(&t, NULL);
-	srand(t.tv_sec ^ t.tv_usec);
-
 	// init error lib
 	log_init(dgn_init());
 
@@ -111,6 +115,15 @@ int main(int argc, char **argv) {
 	config_load(config_path);
 	lang_load();
 
+	// seed random number generator
+	if(config.seed != 0) {
+		rng_init(config.seed);
+	} else {
+		struct timeval t;
+		gettimeofday(&t, NULL);
+		rng_init(t.tv_sec ^ t.tv_usec);
+	}
+
 	void *input_structs[3] = {
 		(void *)&desktop,
 		(void *)&login,
@@ -131,8 +144,11 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "Failed to initialize termbox.\n");
 		abort();
 	}
-	tb_set_output_mode(TB_OUTPUT_NORMAL);
+	colour_init();
+	tb_set_output_mode(colour_mode());
 	tb_clear();
+	present_init();
+	throttle_init();
 
 	// init visible elements
 	struct tb_event event;
@@ -149,15 +165,19 @@ int main(int argc, char **argv) {
 
 	// init drawing stuff
 	draw_init(&buf);
+	arena_init(&frame_arena, FRAME_ARENA_SIZE);
 
-	// draw_box and position_input are called because they need to be
-	// called before *input_handles[active_input] for the cursor to be
-	// positioned correctly
-	draw_box(&buf);
+	if(dgn_catch()) {
+		dgn_reset();
+	}
+
+	// position_input is called because it needs to be called before
+	// *input_handles[active_input] for the cursor to be positioned correctly
 	position_input(&buf, &desktop, &login, &password);
 	(*input_handles[active_input])(input_structs[active_input], NULL);
 
 	if(config.animate) {
+		pool_init(config.animation_threads, config.animation_idle);
 		animation_init(&buf);
 
 		if(dgn_catch()) {
@@ -178,45 +198,101 @@ int main(int argc, char **argv) {
 
 	// main loop
 	while(run) {
-		if(update) {
+		// everything allocated while drawing the previous frame is dropped
+		arena_reset(&frame_arena);
+
+		if(dgn_catch()) {
+			dgn_reset();
+		}
+
+		// the widgets only move once a burst of resizes settled
+		if(layout_due(&buf.layout, monotonic_ms())) {
+			draw_layout(&buf);
+
+			if(dgn_catch()) {
+				config.animate = false;
+				dgn_reset();
+			}
+
+			position_input(&buf, &desktop, &login, &password);
+			update = true;
+		}
+
+		// termbox already has the new size while the layers still have the
+		// previous one, so nothing is drawn until the layout caught up; a
+		// tick of the animation which changed nothing is not drawn either
+		if(config.animate && !buf.layout.pending && auth_fails < 10 &&
+		   animation_timeout(&buf) == 0 && animate(&buf)) {
+			update = true;
+		}
+
+		if(update && !buf.layout.pending) {
 			if(auth_fails < 10) {
 				(*input_handles[active_input])(input_structs[active_input],
 				                               NULL);
-				tb_clear();
-				if(config.animate) {
-					animate(&buf);
-				}
 				draw_bigclock(&buf);
-				draw_box(&buf);
+				draw_static(&buf);
 				draw_clock(&buf);
-				draw_labels(&buf);
-				if(!config.hide_key_hints)
-					draw_key_hints();
+				draw_info_line(&buf);
 				draw_lock_state(&buf);
-				position_input(&buf, &desktop, &login, &password);
-				draw_desktop(&desktop);
-				draw_input(&login);
-				draw_input_mask(&password);
-				update = config.animate;
+				draw_desktop(&buf, &desktop);
+				draw_input(&buf, &login);
+				draw_input_mask(&buf, &password);
+				draw_compose(&buf);
+				update = false;
 			} else {
 				usleep(10000);
 				update = cascade(&buf, &auth_fails);
+
+				// the cascade scrambled the back buffer behind the
+				// compositor's back, so everything has to be recomposed
+				if(!update) {
+					compositor_damage_all(&buf.comp);
+				}
+			}
+
+			present_frame(tb_cell_buffer(), tb_width(), tb_height());
+
+			if(dgn_catch()) {
+				dgn_reset();
 			}
 
-			tb_present();
+			// the terminal can not keep up with the animation
+			if(config.animate && throttle_overloaded()) {
+				animation_stop(&buf);
+				config.animate = false;
+				update = true;
+			}
 		}
 
-		int timeout = -1;
+		// sleeps until the clocks change, the animation takes its next step
+		// or an event comes in, only the clocks need a redraw when the time
+		// is up
+		int timeout = draw_timeout(&buf);
+		bool clock_due = timeout != -1;
+
+		if(update && !buf.layout.pending) {
+			timeout = 0;
+		} else if(config.animate) {
+			// frames are held back while the tty is still sending
+			int tick = animation_timeout(&buf);
+			int delay = throttle_delay();
+
+			if(delay > tick) {
+				tick = delay;
+			}
 
-		if(config.animate) {
-			timeout = config.min_refresh_delta;
-		} else {
-			struct timeval tv;
-			gettimeofday(&tv, NULL);
-			if(config.bigclock)
-				timeout = (60 - tv.tv_sec % 60) * 1000 - tv.tv_usec / 1000 + 1;
-			if(config.clock)
-				timeout = 1000 - tv.tv_usec / 1000 + 1;
+			if(timeout == -1 || tick < timeout) {
+				timeout = tick;
+				clock_due = false;
+			}
+		}
+
+		int settle = layout_timeout(&buf.layout, monotonic_ms());
+
+		if(settle != -1 && (timeout == -1 || settle < timeout)) {
+			timeout = settle;
+			clock_due = false;
 		}
 
 		if(timeout == -1) {
@@ -226,10 +302,14 @@ int main(int argc, char **argv) {
 		}
 
 		if(error < 0) {
+			update = update || clock_due;
 			continue;
 		}
 
 		if(event.type == TB_EVENT_KEY) {
+			// the key may have toggled a lock, sample the leds right away
+			buf.lock_state.next = 0;
+
 			char shutdown_key[4];
 			memset(shutdown_key, '\0', sizeof(shutdown_key));
 			strcpy(shutdown_key, config.shutdown_key);
@@ -295,6 +375,14 @@ int main(int argc, char **argv) {
 					break;
 				case TB_KEY_ENTER:
 					save(&desktop, &login);
+					present_stats_write(config.output_stats);
+					present_suspend();
+
+					// nothing is drawn behind the session's back
+					if(config.animate) {
+						render_wait(&buf);
+					}
+
 					auth(&desktop, &login, &password, &buf);
 					update = true;
 
@@ -318,6 +406,19 @@ int main(int argc, char **argv) {
 
 					load(&desktop, &login);
 					system("tput cnorm");
+
+					// termbox was restarted with a blank screen, possibly
+					// with another size
+					draw_layout(&buf);
+
+					if(dgn_catch()) {
+						config.animate = false;
+						dgn_reset();
+					}
+
+					position_input(&buf, &desktop, &login, &password);
+					compositor_damage_all(&buf.comp);
+					present_invalidate();
 					break;
 				default:
 					(*input_handles[active_input])(input_structs[active_input],
@@ -325,10 +426,14 @@ int main(int argc, char **argv) {
 					update = true;
 					break;
 			}
+		} else if(event.type == TB_EVENT_RESIZE) {
+			layout_resized(&buf.layout, monotonic_ms());
 		}
 	}
 
 	// stop termbox
+	present_stats_write(config.output_stats);
+	present_free();
 	tb_shutdown();
 
 	// free inputs
@@ -336,9 +441,13 @@ int main(int argc, char **argv) {
 	input_text_free(&login);
 	input_text_free(&password);
 	free_hostname();
+	console_close();
 
-	// unload config
+	// unload config, the render thread is stopped before the pool it runs
+	// its jobs on
 	draw_free(&buf);
+	pool_free();
+	arena_free(&frame_arena);
 	lang_free();
 
 	if(shutdown) {
@@ -0,0 +1,125 @@
+#include "pool.h"
+#include "pressure.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// the workers sleep until the generation changes, run their band of the job
+// and the last one to finish wakes the caller, which ran band 0 meanwhile
+static pthread_t workers[POOL_MAX - 1];
+static uint8_t size = 1;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+static uint64_t generation = 0;
+static uint8_t pending = 0;
+static bool quit = false;
+
+static pool_job job = NULL;
+static void *job_ctx = NULL;
+
+static void *worker(void *arg) {
+	uint8_t band = (uintptr_t)arg;
+	uint64_t seen = 0;
+
+	pthread_mutex_lock(&lock);
+
+	while(true) {
+		while(generation == seen && !quit) {
+			pthread_cond_wait(&wake, &lock);
+		}
+
+		// a job handed out before quit is still done, its caller waits for
+		// every band
+		if(generation == seen) {
+			break;
+		}
+
+		seen = generation;
+		pthread_mutex_unlock(&lock);
+
+		job(job_ctx, band, size);
+
+		pthread_mutex_lock(&lock);
+
+		if(--pending == 0) {
+			pthread_cond_signal(&finished);
+		}
+	}
+
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+// starts `threads - 1` workers, the caller is the remaining one; when
+// threads can not be created the jobs are split over fewer bands; `idle`
+// moves the workers to the idle scheduling class
+void pool_init(uint8_t threads, bool idle) {
+	threads = threads < 1 ? 1 : threads > POOL_MAX ? POOL_MAX : threads;
+	quit = false;
+	size = 1;
+
+	while(size < threads) {
+		void *band = (void *)(uintptr_t)size;
+
+		if(pthread_create(&workers[size - 1], NULL, worker, band) != 0) {
+			break;
+		}
+
+		if(idle) {
+			pressure_yield(workers[size - 1]);
+		}
+
+		++size;
+	}
+}
+
+uint8_t pool_size() { return size; }
+
+// returns once every band of the job is done
+void pool_run(pool_job run, void *ctx) {
+	if(size == 1) {
+		run(ctx, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	job = run;
+	job_ctx = ctx;
+	pending = size - 1;
+	++generation;
+	pthread_cond_broadcast(&wake);
+	pthread_mutex_unlock(&lock);
+
+	run(ctx, 0, size);
+
+	pthread_mutex_lock(&lock);
+
+	while(pending > 0) {
+		pthread_cond_wait(&finished, &lock);
+	}
+
+	pthread_mutex_unlock(&lock);
+}
+
+// the part of `len` rows or columns which belongs to `band`
+void pool_span(uint16_t len, uint8_t band, uint8_t bands, uint16_t *start,
+               uint16_t *end) {
+	*start = (uint32_t)len * band / bands;
+	*end = (uint32_t)len * (band + 1) / bands;
+}
+
+void pool_free() {
+	pthread_mutex_lock(&lock);
+	quit = true;
+	pthread_cond_broadcast(&wake);
+	pthread_mutex_unlock(&lock);
+
+	for(uint8_t i = 0; i + 1 < size; ++i) {
+		pthread_join(workers[i], NULL);
+	}
+
+	size = 1;
+}
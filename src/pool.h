@@ -0,0 +1,21 @@
+#ifndef H_LYE_POOL
+#define H_LYE_POOL
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// most threads an animation is split over
+#define POOL_MAX 16
+
+// a job is called once for every band, with the bands of one call running
+// at the same time on different threads
+typedef void (*pool_job)(void *ctx, uint8_t band, uint8_t bands);
+
+void pool_init(uint8_t threads, bool idle);
+uint8_t pool_size();
+void pool_run(pool_job job, void *ctx);
+void pool_span(uint16_t len, uint8_t band, uint8_t bands, uint16_t *start,
+               uint16_t *end);
+void pool_free();
+
+#endif
@@ -0,0 +1,755 @@
+#include "present.h"
+#include "colour.h"
+#include "config.h"
+#include "dragonfail.h"
+#include "fbdev.h"
+#include "throttle.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// frames are written here and not through tb_present: termbox moves the
+// cursor to absolute positions only and resets the whole rendition on
+// every colour change, with no hook to do either differently, so on a
+// slow line most of its bytes are escapes; termbox still owns the cell
+// buffer, the input and the tty setup, but writes nothing once started.
+// the copy of the screen kept here is the only state held twice, it is
+// dropped with present_invalidate whenever the screen was drawn behind
+// its back (a session ran, termbox was restarted)
+
+// upper bound of the bytes needed to move to a cell, set its attributes and
+// print it
+#define CELL_MAX_BYTES 160
+#define SGR_MAX 80
+#define REPRINT_MAX 3
+
+#define ATTR_MASK                                                              \
+	(TB_BOLD | TB_DIM | TB_ITALIC | TB_UNDERLINE | TB_BLINK | TB_REVERSE)
+
+static const struct {
+	uintattr_t attr;
+	uint8_t on;
+	uint8_t off;
+} sgr_attrs[] = {
+	{TB_BOLD, 1, 22},      {TB_DIM, 2, 22},   {TB_ITALIC, 3, 23},
+	{TB_UNDERLINE, 4, 24}, {TB_BLINK, 5, 25}, {TB_REVERSE, 7, 27},
+};
+
+// what the terminal currently shows
+static struct tb_cell *front = NULL;
+static uint16_t front_width = 0;
+static uint16_t front_height = 0;
+static bool front_valid = false;
+
+// hash of every row of `front`, valid once a whole frame has been sent
+static uint64_t *row_hash = NULL;
+static bool row_hash_valid = false;
+
+// terminal cursor and rendition, the position is negative when unknown
+static int term_x = -1;
+static int term_y = -1;
+static bool term_attr_valid = false;
+static uintattr_t term_fg;
+static uintattr_t term_bg;
+static bool term_cursor_shown = false;
+
+// cursor position requested by the inputs, negative when hidden
+static int cursor_x = -1;
+static int cursor_y = -1;
+
+static char *out = NULL;
+static size_t out_len = 0;
+static size_t out_cap = 0;
+
+static struct present_stats stats;
+
+// termbox output mode the colours are encoded for
+static int mode = TB_OUTPUT_NORMAL;
+
+static bool out_reserve(size_t len) // throws
+{
+	if(out_len + len <= out_cap) {
+		return true;
+	}
+
+	size_t cap = out_cap > 0 ? out_cap : 4096;
+
+	while(cap < out_len + len) {
+		cap *= 2;
+	}
+
+	char *new = realloc_or_throw(out, cap);
+
+	if(new == NULL) {
+		return false;
+	}
+
+	out = new;
+	out_cap = cap;
+
+	return true;
+}
+
+static void out_str(const char *str, size_t len) {
+	memcpy(out + out_len, str, len);
+	out_len += len;
+}
+
+static size_t num_len(unsigned num) {
+	return num < 10 ? 1 : num < 100 ? 2 : num < 1000 ? 3 : num < 10000 ? 4 : 5;
+}
+
+static size_t num_into(char *buf, unsigned num) {
+	size_t len = num_len(num);
+
+	for(size_t i = len; i > 0; --i) {
+		buf[i - 1] = '0' + num % 10;
+		num /= 10;
+	}
+
+	return len;
+}
+
+static void out_num(unsigned num) {
+	out_len += num_into(out + out_len, num);
+}
+
+// rough terminal width of a code point, enough for the east asian ranges a
+// hostname or a session name may contain
+static int cell_width(uint32_t ch) {
+	if(ch < 0x1100) {
+		return 1;
+	}
+
+	if((ch <= 0x115f) || (ch >= 0x2e80 && ch <= 0xa4cf) ||
+	   (ch >= 0xac00 && ch <= 0xd7a3) || (ch >= 0xf900 && ch <= 0xfaff) ||
+	   (ch >= 0xfe30 && ch <= 0xfe4f) || (ch >= 0xff00 && ch <= 0xff60) ||
+	   (ch >= 0xffe0 && ch <= 0xffe6) || (ch >= 0x1f300 && ch <= 0x1f64f) ||
+	   (ch >= 0x1f900 && ch <= 0x1f9ff) || (ch >= 0x20000 && ch <= 0x3fffd)) {
+		return 2;
+	}
+
+	return 1;
+}
+
+// colours which are shown alike share their key, UINT32_MAX is the default
+static uint32_t colour_key(uintattr_t colour) {
+	uint8_t index = colour & 0xff;
+
+	switch(mode) {
+		case TB_OUTPUT_256:
+			return (index == 0 && !(colour & TB_HI_BLACK)) ? UINT32_MAX : index;
+#if TB_OPT_ATTR_W == 32
+		case TB_OUTPUT_TRUECOLOR:
+			return ((colour & 0xffffff) == 0 && !(colour & TB_HI_BLACK))
+			           ? UINT32_MAX
+			           : colour & 0xffffff;
+#endif
+		default:
+			// anything outside of the eight ansi colours is the default
+			if(index == 0 || index > 8) {
+				return UINT32_MAX;
+			}
+
+			return (colour & TB_BRIGHT) ? index + 8 : index;
+	}
+}
+
+static uintattr_t sgr_attr(uintattr_t fg, uintattr_t bg) {
+	return (fg & ATTR_MASK) | (bg & TB_REVERSE);
+}
+
+// cells are compared by what the terminal would show
+static bool cell_same(const struct tb_cell *a, const struct tb_cell *b) {
+	return (a->ch == b->ch) &&
+	       (colour_key(a->fg) == colour_key(b->fg)) &&
+	       (colour_key(a->bg) == colour_key(b->bg)) &&
+	       (sgr_attr(a->fg, a->bg) == sgr_attr(b->fg, b->bg));
+}
+
+static size_t sgr_code(char *buf, size_t len, uint8_t code) {
+	if(len > 0) {
+		buf[len++] = ';';
+	}
+
+	return len + num_into(buf + len, code);
+}
+
+static size_t sgr_colour(char *buf, size_t len, uintattr_t colour,
+                         uint8_t base) {
+	uint32_t key = colour_key(colour);
+
+	if(key == UINT32_MAX) {
+		return sgr_code(buf, len, base + 9);
+	}
+
+	switch(mode) {
+		case TB_OUTPUT_256:
+			len = sgr_code(buf, len, base + 8);
+			len = sgr_code(buf, len, 5);
+			return sgr_code(buf, len, key);
+#if TB_OPT_ATTR_W == 32
+		case TB_OUTPUT_TRUECOLOR:
+			len = sgr_code(buf, len, base + 8);
+			len = sgr_code(buf, len, 2);
+			len = sgr_code(buf, len, key >> 16);
+			len = sgr_code(buf, len, (key >> 8) & 0xff);
+			return sgr_code(buf, len, key & 0xff);
+#endif
+		default:
+			return sgr_code(buf, len,
+			                key > 8 ? base + 60 + key - 9 : base + key - 1);
+	}
+}
+
+// builds the parameters of a full reset followed by the whole rendition
+static size_t sgr_full(char *buf, uintattr_t fg, uintattr_t bg) {
+	uintattr_t attr = sgr_attr(fg, bg);
+	size_t len = sgr_code(buf, 0, 0);
+
+	for(size_t i = 0; i < ARRAY_LENGTH(sgr_attrs); ++i) {
+		if(attr & sgr_attrs[i].attr) {
+			len = sgr_code(buf, len, sgr_attrs[i].on);
+		}
+	}
+
+	if(colour_key(fg) != UINT32_MAX) {
+		len = sgr_colour(buf, len, fg, 30);
+	}
+
+	if(colour_key(bg) != UINT32_MAX) {
+		len = sgr_colour(buf, len, bg, 40);
+	}
+
+	return len;
+}
+
+// builds the parameters which only change what differs from the terminal
+static size_t sgr_delta(char *buf, uintattr_t fg, uintattr_t bg) {
+	uintattr_t attr = sgr_attr(fg, bg);
+	uintattr_t cur = sgr_attr(term_fg, term_bg);
+	uintattr_t removed = cur & ~attr;
+	uintattr_t added = attr & ~cur;
+	size_t len = 0;
+
+	// bold and dim share their reset
+	if(removed & (TB_BOLD | TB_DIM)) {
+		len = sgr_code(buf, len, 22);
+		added |= attr & (TB_BOLD | TB_DIM);
+		removed &= ~(TB_BOLD | TB_DIM);
+	}
+
+	for(size_t i = 0; i < ARRAY_LENGTH(sgr_attrs); ++i) {
+		if(removed & sgr_attrs[i].attr) {
+			len = sgr_code(buf, len, sgr_attrs[i].off);
+		}
+
+		if(added & sgr_attrs[i].attr) {
+			len = sgr_code(buf, len, sgr_attrs[i].on);
+		}
+	}
+
+	if(colour_key(fg) != colour_key(term_fg)) {
+		len = sgr_colour(buf, len, fg, 30);
+	}
+
+	if(colour_key(bg) != colour_key(term_bg)) {
+		len = sgr_colour(buf, len, bg, 40);
+	}
+
+	return len;
+}
+
+static void set_attr(uintattr_t fg, uintattr_t bg) {
+	if(term_attr_valid && fg == term_fg && bg == term_bg) {
+		return;
+	}
+
+	char full[SGR_MAX];
+	size_t full_len = sgr_full(full, fg, bg);
+	const char *sgr = full;
+	size_t len = full_len;
+
+	char delta[SGR_MAX];
+
+	if(term_attr_valid && config.optimize_output) {
+		size_t delta_len = sgr_delta(delta, fg, bg);
+
+		if(delta_len < full_len) {
+			sgr = delta;
+			len = delta_len;
+		}
+	}
+
+	if(len > 0) {
+		out_str("\x1b[", 2);
+		out_str(sgr, len);
+		out_str("m", 1);
+	}
+
+	term_fg = fg;
+	term_bg = bg;
+	term_attr_valid = true;
+}
+
+// cursor movements, each returns its length in bytes and is only written
+// out when `emit` is set
+
+static size_t move_abs(int x, int y, bool emit) {
+	size_t len = 3 + (x > 0 || y > 0 ? num_len(y + 1) : 0) +
+	             (x > 0 ? 1 + num_len(x + 1) : 0);
+
+	if(emit) {
+		out_str("\x1b[", 2);
+
+		if(x > 0 || y > 0) {
+			out_num(y + 1);
+		}
+
+		if(x > 0) {
+			out_str(";", 1);
+			out_num(x + 1);
+		}
+
+		out_str("H", 1);
+	}
+
+	return len;
+}
+
+static size_t move_csi(int n, char final, bool emit) {
+	size_t len = 3 + (n > 1 ? num_len(n) : 0);
+
+	if(emit) {
+		out_str("\x1b[", 2);
+
+		if(n > 1) {
+			out_num(n);
+		}
+
+		out_str(&final, 1);
+	}
+
+	return len;
+}
+
+static size_t move_vertical(int from, int to, bool emit) {
+	if(to == from) {
+		return 0;
+	}
+
+	// output processing is off in raw mode, so a line feed keeps the column
+	if(to == from + 1) {
+		if(emit) {
+			out_str("\n", 1);
+		}
+
+		return 1;
+	}
+
+	return to > from ? move_csi(to - from, 'B', emit)
+	                 : move_csi(from - to, 'A', emit);
+}
+
+// moving right over cells which are already shown can be done by printing
+// them again, as long as the current rendition matches
+static size_t reprint(const struct tb_cell *row, int from, int to, bool emit) {
+	if(to - from > REPRINT_MAX || !term_attr_valid) {
+		return SIZE_MAX;
+	}
+
+	for(int i = from; i < to; ++i) {
+		if(row[i].ch < 0x20 || row[i].ch >= 0x7f || row[i].fg != term_fg ||
+		   row[i].bg != term_bg) {
+			return SIZE_MAX;
+		}
+	}
+
+	if(emit) {
+		for(int i = from; i < to; ++i) {
+			out[out_len++] = (char)row[i].ch;
+		}
+	}
+
+	return to - from;
+}
+
+static size_t move_right(const struct tb_cell *row, int from, int to,
+                         bool emit) {
+	if(to == from) {
+		return 0;
+	}
+
+	size_t csi = move_csi(to - from, 'C', false);
+	size_t again = reprint(row, from, to, false);
+
+	if(again <= csi) {
+		return reprint(row, from, to, emit);
+	}
+
+	return move_csi(to - from, 'C', emit);
+}
+
+static size_t move_horizontal(const struct tb_cell *row, int from, int to,
+                              bool emit) {
+	if(to >= from) {
+		return move_right(row, from, to, emit);
+	}
+
+	size_t home = 1 + move_right(row, 0, to, false);
+	size_t back = from - to;
+	size_t csi = move_csi(from - to, 'D', false);
+
+	if(home <= back && home <= csi) {
+		if(emit) {
+			out_str("\r", 1);
+			move_right(row, 0, to, true);
+		}
+
+		return home;
+	}
+
+	if(back <= csi) {
+		if(emit) {
+			for(int i = to; i < from; ++i) {
+				out_str("\b", 1);
+			}
+		}
+
+		return back;
+	}
+
+	return move_csi(from - to, 'D', emit);
+}
+
+static void move_to(const struct tb_cell *row, int x, int y) {
+	if(x == term_x && y == term_y) {
+		return;
+	}
+
+	size_t abs = move_abs(x, y, false);
+
+	if(term_x >= 0 && config.optimize_output) {
+		size_t rel = move_vertical(term_y, y, false) +
+		             move_horizontal(row, term_x, x, false);
+
+		if(rel < abs) {
+			move_vertical(term_y, y, true);
+			move_horizontal(row, term_x, x, true);
+			term_x = x;
+			term_y = y;
+			return;
+		}
+	}
+
+	move_abs(x, y, true);
+	term_x = x;
+	term_y = y;
+}
+
+static void put_cell(const struct tb_cell *cell, int x, uint16_t width) {
+	uint32_t ch = cell->ch;
+	int w = cell_width(ch);
+
+	// nothing that would move the cursor on its own is printed
+	if(ch < 0x20 || ch == 0x7f || (w == 2 && x + 1 >= width)) {
+		ch = ' ';
+		w = 1;
+	}
+
+	set_attr(cell->fg, cell->bg);
+
+	if(ch < 0x80) {
+		out[out_len++] = (char)ch;
+	} else {
+		out_len += tb_utf8_unicode_to_char(out + out_len, ch);
+	}
+
+	term_x += w;
+
+	// the cursor is left in the pending wrap state after the last column,
+	// where terminals disagree on relative movements
+	if(term_x >= width) {
+		term_x = -1;
+	}
+}
+
+// 64 bit multiply-xorshift over the raw cells, reading a word at a time
+static uint64_t hash_row(const struct tb_cell *row, uint16_t width) {
+	const uint8_t *bytes = (const uint8_t *)row;
+	size_t len = sizeof(*row) * width;
+	uint64_t hash = 0x9e3779b97f4a7c15 ^ len;
+	size_t i = 0;
+
+	for(; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * 0xff51afd7ed558ccd;
+		hash ^= hash >> 32;
+	}
+
+	for(; i < len; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3;
+	}
+
+	return hash ^ (hash >> 29);
+}
+
+static void front_resize(uint16_t width, uint16_t height) // throws
+{
+	free(front);
+	free(row_hash);
+	front = NULL;
+	row_hash = NULL;
+	front_width = 0;
+	front_height = 0;
+
+	struct tb_cell *cells =
+		malloc_or_throw(sizeof(*cells) * width * height); // NOLINT
+
+	if(cells == NULL) {
+		return;
+	}
+
+	uint64_t *hashes = malloc_or_throw(sizeof(*hashes) * height);
+
+	if(hashes == NULL) {
+		free(cells);
+		return;
+	}
+
+	front = cells;
+	row_hash = hashes;
+	front_width = width;
+	front_height = height;
+	front_valid = false;
+}
+
+// starts from a cleared screen, the blank cells then don't have to be sent
+static void front_clear() {
+	const struct tb_cell blank = {' ', TB_DEFAULT, TB_DEFAULT};
+
+	term_attr_valid = false;
+	set_attr(TB_DEFAULT, TB_DEFAULT);
+	out_str("\x1b[H\x1b[2J", 7);
+	term_x = 0;
+	term_y = 0;
+
+	for(size_t i = 0; i < (size_t)front_width * front_height; ++i) {
+		front[i] = blank;
+	}
+
+	front_valid = true;
+	row_hash_valid = false;
+}
+
+static void out_flush(int fd) {
+	size_t done = 0;
+
+	throttle_sample(fd);
+	uint64_t start = monotonic_ms();
+
+	while(done < out_len) {
+		ssize_t len = write(fd, out + done, out_len - done);
+
+		if(len < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if(errno == EAGAIN) {
+				struct pollfd pfd = {fd, POLLOUT, 0};
+				poll(&pfd, 1, -1);
+				continue;
+			}
+
+			// whatever the terminal got is unknown, start over next frame
+			present_invalidate();
+			break;
+		}
+
+		done += len;
+	}
+
+	throttle_sent(out_len, monotonic_ms() - start);
+
+	stats.frames += 1;
+	stats.bytes += out_len;
+	stats.last = out_len;
+
+	if(stats.last > stats.max) {
+		stats.max = stats.last;
+	}
+
+	out_len = 0;
+}
+
+void present_init() {
+	memset(&stats, 0, sizeof(stats));
+	mode = colour_mode();
+	present_invalidate();
+
+	// the terminal stays in use when the framebuffer can not be opened
+	if(config.fb_device != NULL) {
+		fbdev_open(config.fb_device, config.fb_geometry);
+	}
+}
+
+void present_free() {
+	fbdev_close();
+	free(front);
+	free(row_hash);
+	free(out);
+	front = NULL;
+	row_hash = NULL;
+	out = NULL;
+	front_width = 0;
+	front_height = 0;
+	out_cap = 0;
+	out_len = 0;
+}
+
+// forgets everything known about the terminal, the next frame is drawn in
+// full, termbox hides the cursor whenever it is initialized
+void present_invalidate() {
+	front_valid = false;
+	term_x = -1;
+	term_y = -1;
+	term_attr_valid = false;
+	term_cursor_shown = false;
+	fbdev_invalidate();
+}
+
+// hands the console back before a session is started
+void present_suspend() {
+	fbdev_suspend();
+}
+
+void present_cursor(int x, int y) {
+	cursor_x = x;
+	cursor_y = y;
+}
+
+// sends the cells which differ from what the terminal shows, using the
+// shortest cursor movements and rendition changes it can find
+void present_frame(const struct tb_cell *cells, uint16_t width,
+                   uint16_t height) // throws
+{
+	int fd;
+	int resize_fd;
+
+	if(fbdev_active()) {
+		fbdev_frame(cells, width, height, cursor_x, cursor_y);
+		stats.frames += 1;
+		return;
+	}
+
+	if(tb_get_fds(&fd, &resize_fd) != TB_OK || cells == NULL) {
+		return;
+	}
+
+	if(width != front_width || height != front_height) {
+		front_resize(width, height);
+
+		if(front == NULL) {
+			return;
+		}
+	}
+
+	if(!out_reserve(CELL_MAX_BYTES)) {
+		return;
+	}
+
+	if(!front_valid) {
+		front_clear();
+	}
+
+	for(uint16_t y = 0; y < height; ++y) {
+		const struct tb_cell *row = cells + (size_t)y * width;
+		struct tb_cell *front_row = front + (size_t)y * width;
+		uint64_t hash = hash_row(row, width);
+
+		// rows which hash like the one on screen are not compared at all
+		if(row_hash_valid && hash == row_hash[y]) {
+			continue;
+		}
+
+		row_hash[y] = hash;
+
+		for(uint16_t x = 0; x < width; ++x) {
+			if(cell_same(&front_row[x], &row[x])) {
+				continue;
+			}
+
+			if(!out_reserve(CELL_MAX_BYTES)) {
+				front_valid = false;
+				row_hash_valid = false;
+				out_flush(fd);
+				return;
+			}
+
+			move_to(row, x, y);
+			put_cell(&row[x], x, width);
+			front_row[x] = row[x];
+
+			// the terminal draws over the next cell as well
+			if(cell_width(row[x].ch) == 2 && x + 1 < width) {
+				++x;
+				front_row[x] = row[x];
+			}
+		}
+	}
+
+	row_hash_valid = true;
+
+	if(cursor_x >= 0 && cursor_y >= 0 && cursor_x < width &&
+	   cursor_y < height) {
+		move_to(cells + (size_t)cursor_y * width, cursor_x, cursor_y);
+
+		if(!term_cursor_shown) {
+			out_str("\x1b[?25h", 6);
+			term_cursor_shown = true;
+		}
+	} else if(term_cursor_shown) {
+		out_str("\x1b[?25l", 6);
+		term_cursor_shown = false;
+	}
+
+	out_flush(fd);
+}
+
+const struct present_stats *present_stats() {
+	return &stats;
+}
+
+void present_stats_write(const char *path) {
+	if(path == NULL || strlen(path) == 0) {
+		return;
+	}
+
+	FILE *file = fopen(path, "w");
+
+	if(file == NULL) {
+		return;
+	}
+
+	uint64_t avg = stats.frames > 0 ? stats.bytes / stats.frames : 0;
+
+	fprintf(file,
+	        "mode %s\nframes %" PRIu64 "\nbytes %" PRIu64
+	        "\nbytes_per_frame %" PRIu64 "\nmax_frame %" PRIu32
+	        "\nlast_frame %" PRIu32 "\n",
+	        colour_mode_name(), stats.frames, stats.bytes, avg, stats.max,
+	        stats.last);
+
+	fclose(file);
+}
@@ -0,0 +1,27 @@
+#ifndef H_LYE_PRESENT
+#define H_LYE_PRESENT
+
+#include "termbox2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// bytes sent to the terminal, to compare output strategies
+struct present_stats {
+	uint64_t frames;
+	uint64_t bytes;
+	uint32_t last;
+	uint32_t max;
+};
+
+void present_init();
+void present_free();
+void present_invalidate();
+void present_suspend();
+void present_cursor(int x, int y);
+void present_frame(const struct tb_cell *cells, uint16_t width,
+                   uint16_t height); // throws
+const struct present_stats *present_stats();
+void present_stats_write(const char *path);
+
+#endif
@@ -0,0 +1,204 @@
+#include "pressure.h"
+#include "config.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sched.h>
+
+// only declared for _GNU_SOURCE, the value is part of the kernel abi
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+#endif
+
+// the averages the kernel keeps move slowly, they are read once a second
+#define PRESSURE_PERIOD_MS 1000
+
+#define PRESSURE_PSI "/proc/pressure/cpu"
+#define PRESSURE_LOADAVG "/proc/loadavg"
+
+// percent of the last 10 seconds tasks waited for a cpu, and the load of
+// the last minute per cpu in percent, from which the tick is stretched by
+// one more step
+static const uint16_t psi_steps[PRESSURE_STRETCH_MAX - 1] = {10, 30, 60};
+static const uint16_t load_steps[PRESSURE_STRETCH_MAX - 1] = {100, 150, 200};
+
+// the files are opened once and read from their start into a buffer on the
+// stack, so a reading does not allocate
+static int psi_fd = -1;
+static int loadavg_fd = -1;
+static long cpus = 1;
+
+static uint64_t sampled = 0;
+static uint8_t stretch = 1;
+
+static bool read_text(int fd, char *text, size_t len) {
+	if(fd < 0) {
+		return false;
+	}
+
+	ssize_t got = pread(fd, text, len - 1, 0);
+
+	if(got <= 0) {
+		return false;
+	}
+
+	text[got] = '\0';
+	return true;
+}
+
+// a decimal like `12.34` in hundredths
+static bool parse_hundredths(const char *text, uint32_t *value) {
+	uint32_t whole = 0;
+	uint32_t fraction = 0;
+	const char *start = text;
+
+	while(*text >= '0' && *text <= '9' && whole < UINT32_MAX / 1000) {
+		whole = whole * 10 + (*text - '0');
+		++text;
+	}
+
+	if(text == start) {
+		return false;
+	}
+
+	if(*text == '.') {
+		++text;
+	}
+
+	for(uint8_t i = 0; i < 2; ++i) {
+		fraction *= 10;
+
+		if(*text >= '0' && *text <= '9') {
+			fraction += *text - '0';
+			++text;
+		}
+	}
+
+	*value = whole * 100 + fraction;
+	return true;
+}
+
+// the kernel may be built without psi or have it turned off, then the file
+// is missing or can not be read
+static bool read_psi(uint16_t *percent) {
+	const char prefix[] = "some avg10=";
+	char text[128];
+	uint32_t value;
+
+	if(!read_text(psi_fd, text, sizeof(text)) ||
+	   strncmp(text, prefix, sizeof(prefix) - 1) != 0 ||
+	   !parse_hundredths(text + sizeof(prefix) - 1, &value)) {
+		return false;
+	}
+
+	value /= 100;
+	*percent = value > 100 ? 100 : value;
+
+	return true;
+}
+
+static bool read_loadavg(uint16_t *percent) {
+	char text[128];
+	uint32_t value;
+
+	if(!read_text(loadavg_fd, text, sizeof(text)) ||
+	   !parse_hundredths(text, &value)) {
+		return false;
+	}
+
+	uint32_t load = value / cpus;
+	*percent = load > UINT16_MAX ? UINT16_MAX : load;
+
+	return true;
+}
+
+static uint8_t steps(uint16_t percent, const uint16_t *thresholds) {
+	uint8_t result = 1;
+
+	while(result < PRESSURE_STRETCH_MAX &&
+	      percent >= thresholds[result - 1]) {
+		++result;
+	}
+
+	return result;
+}
+
+void pressure_init() {
+	sampled = 0;
+	stretch = 1;
+
+	if(!config.animation_pressure) {
+		return;
+	}
+
+	psi_fd = open(PRESSURE_PSI, O_RDONLY | O_CLOEXEC);
+	loadavg_fd = open(PRESSURE_LOADAVG, O_RDONLY | O_CLOEXEC);
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cpus = cpus < 1 ? 1 : cpus;
+}
+
+void pressure_free() {
+	if(psi_fd >= 0) {
+		close(psi_fd);
+	}
+
+	if(loadavg_fd >= 0) {
+		close(loadavg_fd);
+	}
+
+	psi_fd = -1;
+	loadavg_fd = -1;
+}
+
+// rereads how busy the system is when the last reading is old enough
+void pressure_sample(uint64_t now) {
+	uint16_t percent;
+
+	if(!config.animation_pressure ||
+	   (sampled != 0 && now - sampled < PRESSURE_PERIOD_MS)) {
+		return;
+	}
+
+	sampled = now;
+
+	if(read_psi(&percent)) {
+		stretch = steps(percent, psi_steps);
+		return;
+	}
+
+	// psi which can not be read now never will be
+	if(psi_fd >= 0) {
+		close(psi_fd);
+		psi_fd = -1;
+	}
+
+	if(read_loadavg(&percent)) {
+		stretch = steps(percent, load_steps);
+	} else {
+		stretch = 1;
+	}
+}
+
+// how many times longer the animation waits between two frames
+uint8_t pressure_stretch() {
+	return config.animation_pressure ? stretch : 1;
+}
+
+// moves an animation thread to the idle class, where it only runs on cpus
+// nothing else wants; stays in its class where there is none
+void pressure_yield(pthread_t thread) {
+#if defined(__linux__)
+	struct sched_param param = {0};
+	pthread_setschedparam(thread, SCHED_IDLE, &param);
+#else
+	UNUSED(thread);
+#endif
+}
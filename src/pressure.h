@@ -0,0 +1,16 @@
+#ifndef H_LYE_PRESSURE
+#define H_LYE_PRESSURE
+
+#include <pthread.h>
+#include <stdint.h>
+
+// most times the animation tick is stretched by on a busy system
+#define PRESSURE_STRETCH_MAX 4
+
+void pressure_init();
+void pressure_free();
+void pressure_sample(uint64_t now);
+uint8_t pressure_stretch();
+void pressure_yield(pthread_t thread);
+
+#endif
@@ -0,0 +1,296 @@
+#include "render.h"
+#include "animations.h"
+#include "config.h"
+#include "draw.h"
+#include "pressure.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t monotonic_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// draws the frame handed out last and keeps what it cost
+static void render_draw(struct render *render) {
+	uint64_t start = monotonic_us();
+
+	render->changed = animation_draw(render->buf, &render->occlusion,
+	                                 render->now, render->dt);
+	render->cost_us = monotonic_us() - start;
+	render->ready = true;
+}
+
+static void *render_thread(void *arg) {
+	struct render *render = arg;
+
+	pthread_mutex_lock(&render->lock);
+
+	while(true) {
+		while(!render->busy && !render->quit) {
+			pthread_cond_wait(&render->wake, &render->lock);
+		}
+
+		if(render->quit) {
+			break;
+		}
+
+		pthread_mutex_unlock(&render->lock);
+		render_draw(render);
+		pthread_mutex_lock(&render->lock);
+		render->busy = false;
+		pthread_cond_broadcast(&render->idle);
+	}
+
+	pthread_mutex_unlock(&render->lock);
+	return NULL;
+}
+
+// when the thread can not be started the frames are drawn on the main
+// thread as they are handed out, one frame ahead all the same
+void render_start(struct term_buf *buf) // throws
+{
+	struct render *render = &buf->render;
+
+	memset(render, 0, sizeof(*render));
+	render->buf = buf;
+	render_resize(buf);
+
+	if(pthread_mutex_init(&render->lock, NULL) != 0) {
+		return;
+	}
+
+	if(pthread_cond_init(&render->wake, NULL) != 0) {
+		pthread_mutex_destroy(&render->lock);
+		return;
+	}
+
+	if(pthread_cond_init(&render->idle, NULL) != 0) {
+		pthread_cond_destroy(&render->wake);
+		pthread_mutex_destroy(&render->lock);
+		return;
+	}
+
+	if(pthread_create(&render->thread, NULL, render_thread, render) != 0) {
+		pthread_cond_destroy(&render->idle);
+		pthread_cond_destroy(&render->wake);
+		pthread_mutex_destroy(&render->lock);
+		return;
+	}
+
+	if(config.animation_idle) {
+		pressure_yield(render->thread);
+	}
+
+	render->started = true;
+}
+
+// every row of the canvas is published again with the next frame
+static void render_damage_all(struct render *render) {
+	for(uint16_t y = 0; y < render->height; ++y) {
+		render->damage[y] = (struct span){0, render->width};
+	}
+}
+
+static void render_release(struct term_buf *buf) {
+	struct render *render = &buf->render;
+
+	free(render->cells);
+	free(render->damage);
+	render->cells = NULL;
+	render->damage = NULL;
+	render->width = 0;
+	render->height = 0;
+	buf->canvas = NULL;
+	buf->canvas_damage = NULL;
+}
+
+// called with the thread idle once the layers were resized and cleared; a
+// canvas of the same size is kept for the animation to go on drawing into,
+// one for the previous size is dropped with the frame drawn on it
+void render_resize(struct term_buf *buf) // throws
+{
+	struct render *render = &buf->render;
+	uint16_t width = buf->comp.width;
+	uint16_t height = buf->comp.height;
+	size_t len = (size_t)width * height;
+
+	if(render->cells != NULL && width == render->width &&
+	   height == render->height) {
+		render_damage_all(render);
+		return;
+	}
+
+	render_release(buf);
+	render->ready = false;
+
+	if(len == 0) {
+		return;
+	}
+
+	render->cells = malloc_or_throw(len * sizeof(*render->cells));
+
+	if(render->cells == NULL) {
+		return;
+	}
+
+	render->damage = malloc_or_throw(height * sizeof(*render->damage));
+
+	if(render->damage == NULL) {
+		render_release(buf);
+		return;
+	}
+
+	memset(render->cells, 0, len * sizeof(*render->cells));
+	memset(render->damage, 0, height * sizeof(*render->damage));
+	render->width = width;
+	render->height = height;
+	buf->canvas = render->cells;
+	buf->canvas_damage = render->damage;
+}
+
+// clears the canvas and drops a frame finished on it, the next frame is
+// drawn from scratch and published as a whole; only while the thread is idle
+void render_clear(struct term_buf *buf) {
+	struct render *render = &buf->render;
+
+	if(render->cells == NULL) {
+		return;
+	}
+
+	memset(render->cells, 0,
+	       (size_t)render->width * render->height * sizeof(*render->cells));
+	render_damage_all(render);
+	render->ready = false;
+}
+
+// copies the rows the animation changed into the layer, returns false when
+// there were none
+static bool render_publish(struct term_buf *buf) {
+	struct render *render = &buf->render;
+	struct tb_cell *layer = buf->comp.layers[LAYER_ANIMATION].cells;
+	bool changed = false;
+
+	if(render->width != buf->comp.width ||
+	   render->height != buf->comp.height) {
+		return false;
+	}
+
+	for(uint16_t y = 0; y < render->height; ++y) {
+		struct span *span = &render->damage[y];
+		size_t i = (size_t)y * render->width + span->x;
+
+		if(span->end <= span->x) {
+			continue;
+		}
+
+		memcpy(layer + i, render->cells + i,
+		       (span->end - span->x) * sizeof(*render->cells));
+		compositor_damage_row(&buf->comp, y, span->x, span->end);
+		*span = (struct span){0};
+		changed = true;
+	}
+
+	return changed;
+}
+
+// publishes the frame the thread finished, if any; returns false without
+// waiting when the thread is still drawing, `cost_us` is the time the frame
+// took
+bool render_collect(struct term_buf *buf, bool *changed, uint32_t *cost_us) {
+	struct render *render = &buf->render;
+
+	*changed = false;
+	*cost_us = 0;
+
+	if(render->started) {
+		pthread_mutex_lock(&render->lock);
+
+		if(render->busy) {
+			pthread_mutex_unlock(&render->lock);
+			return false;
+		}
+	}
+
+	if(render->ready && render->changed) {
+		*changed = render_publish(buf);
+		*cost_us = render->cost_us;
+	}
+
+	render->ready = false;
+
+	if(render->started) {
+		pthread_mutex_unlock(&render->lock);
+	}
+
+	return true;
+}
+
+// hands out the next frame, only after render_collect returned true
+void render_kick(struct term_buf *buf, uint64_t now, uint32_t dt) {
+	struct render *render = &buf->render;
+
+	if(!render->started) {
+		render->now = now;
+		render->dt = dt;
+		render->occlusion = buf->occlusion;
+		render_draw(render);
+		return;
+	}
+
+	pthread_mutex_lock(&render->lock);
+	render->now = now;
+	render->dt = dt;
+	render->occlusion = buf->occlusion;
+	render->busy = true;
+	pthread_cond_signal(&render->wake);
+	pthread_mutex_unlock(&render->lock);
+}
+
+// the animation state, the canvas and the sizes may only change while the
+// thread is idle
+void render_wait(struct term_buf *buf) {
+	struct render *render = &buf->render;
+
+	if(!render->started) {
+		return;
+	}
+
+	pthread_mutex_lock(&render->lock);
+
+	while(render->busy) {
+		pthread_cond_wait(&render->idle, &render->lock);
+	}
+
+	pthread_mutex_unlock(&render->lock);
+}
+
+void render_stop(struct term_buf *buf) {
+	struct render *render = &buf->render;
+
+	if(!render->started) {
+		render_release(buf);
+		return;
+	}
+
+	pthread_mutex_lock(&render->lock);
+	render->quit = true;
+	pthread_cond_signal(&render->wake);
+	pthread_mutex_unlock(&render->lock);
+
+	pthread_join(render->thread, NULL);
+	pthread_cond_destroy(&render->idle);
+	pthread_cond_destroy(&render->wake);
+	pthread_mutex_destroy(&render->lock);
+
+	render_release(buf);
+	render->started = false;
+}
@@ -0,0 +1,51 @@
+#ifndef H_LYE_RENDER
+#define H_LYE_RENDER
+
+#include "compositor.h"
+#include "termbox2.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct term_buf;
+
+// the animation is drawn on its own thread into `cells`, one frame ahead of
+// the frame on screen, so input never waits for a slow animation frame
+struct render {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t idle;
+	bool started;
+	bool quit;
+
+	// the thread owns `cells` and the animation state while busy, a frame
+	// it finished waits in `cells` until it is published
+	bool busy;
+	bool ready;
+	bool changed;
+	uint32_t cost_us;
+
+	// what the frame is drawn for, copied when it is handed out
+	uint64_t now;
+	uint32_t dt;
+	struct occlusion occlusion;
+
+	// what changed in `cells` since they were last published, per row
+	struct tb_cell *cells;
+	struct span *damage;
+	uint16_t width;
+	uint16_t height;
+	struct term_buf *buf;
+};
+
+void render_start(struct term_buf *buf); // throws
+void render_resize(struct term_buf *buf); // throws
+void render_clear(struct term_buf *buf);
+bool render_collect(struct term_buf *buf, bool *changed, uint32_t *cost_us);
+void render_kick(struct term_buf *buf, uint64_t now, uint32_t dt);
+void render_wait(struct term_buf *buf);
+void render_stop(struct term_buf *buf);
+
+#endif
@@ -0,0 +1,128 @@
+#include "throttle.h"
+#include "config.h"
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+// shortest interval the drain rate is measured over
+#define THROTTLE_SAMPLE_MS 20
+// consecutive frames over budget before the animation is given up
+#define THROTTLE_STRIKES 16
+
+// the output queue of the tty is sampled before every frame, the bytes which
+// left it since the previous sample give how fast the line drains
+static int tty_fd = -1;
+static uint64_t ref_time = 0;
+static uint32_t ref_queued = 0;
+static uint32_t written = 0;
+
+// bytes per second the line drains with a backlog, 0 until measured
+static uint32_t rate = 0;
+// averages over the last frames
+static uint32_t frame_bytes = 0;
+static uint32_t frame_write_ms = 0;
+static uint8_t strikes = 0;
+
+static uint32_t queued() {
+	int len = 0;
+
+	if(tty_fd < 0 || ioctl(tty_fd, TIOCOUTQ, &len) < 0 || len < 0) {
+		return 0;
+	}
+
+	return len;
+}
+
+void throttle_init() {
+	tty_fd = -1;
+	ref_time = 0;
+	ref_queued = 0;
+	written = 0;
+	rate = 0;
+	frame_bytes = 0;
+	frame_write_ms = 0;
+	strikes = 0;
+}
+
+// called right before a frame is written to `fd`
+void throttle_sample(int fd) {
+	uint64_t now = monotonic_ms();
+
+	if(fd != tty_fd) {
+		tty_fd = fd;
+		ref_time = now;
+		ref_queued = queued();
+		written = 0;
+		return;
+	}
+
+	uint64_t elapsed = now - ref_time;
+
+	if(elapsed < THROTTLE_SAMPLE_MS) {
+		return;
+	}
+
+	uint32_t now_queued = queued();
+	uint64_t sent = (uint64_t)ref_queued + written;
+	uint64_t drained = sent > now_queued ? sent - now_queued : 0;
+	uint32_t measured = drained * 1000 / elapsed;
+
+	// only a line which was busy all along drains at its actual rate, with
+	// the queue run dry this is just what was offered to it
+	if(now_queued > 0) {
+		rate = rate == 0 ? measured : (3 * (uint64_t)rate + measured) / 4;
+	}
+
+	ref_time = now;
+	ref_queued = now_queued;
+	written = 0;
+}
+
+// called once a frame of `bytes` was written, which took `write_ms`
+void throttle_sent(uint32_t bytes, uint32_t write_ms) {
+	written += bytes;
+	frame_bytes = (3 * (uint64_t)frame_bytes + bytes) / 4;
+	frame_write_ms = (3 * frame_write_ms + write_ms) / 4;
+
+	if(config.output_budget == 0) {
+		return;
+	}
+
+	// only a frame which left a backlog, in the queue or as a write which
+	// had to wait for room in it, tells how long the line takes to drain
+	if(write_ms == 0 && queued() == 0) {
+		return;
+	}
+
+	// a key echoed right after a frame waits for the whole frame to drain
+	uint64_t frame_ms = frame_write_ms;
+
+	if(rate > 0) {
+		frame_ms += (uint64_t)frame_bytes * 1000 / rate;
+	}
+
+	if(frame_ms > config.output_budget) {
+		if(strikes < THROTTLE_STRIKES) {
+			++strikes;
+		}
+	} else {
+		strikes = 0;
+	}
+}
+
+// milliseconds until the output queue is empty again, the next animation
+// frame is held back until then so input echo never waits behind a backlog
+int throttle_delay() {
+	if(config.output_budget == 0 || rate == 0) {
+		return 0;
+	}
+
+	return (uint64_t)queued() * 1000 / rate;
+}
+
+// true once single frames take longer to drain than the output budget
+bool throttle_overloaded() {
+	return config.output_budget > 0 && strikes >= THROTTLE_STRIKES;
+}
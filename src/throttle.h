@@ -0,0 +1,13 @@
+#ifndef H_LYE_THROTTLE
+#define H_LYE_THROTTLE
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void throttle_init();
+void throttle_sample(int fd);
+void throttle_sent(uint32_t bytes, uint32_t write_ms);
+int throttle_delay();
+bool throttle_overloaded();
+
+#endif
@@ -0,0 +1,389 @@
+// lye-art, converts ANSI art to the cell format lye maps at startup
+//
+//   lye-art [-m normal|256|truecolor] [-w width] input output
+//
+// the input is read as UTF-8 text with SGR colour sequences and cursor
+// movements; spaces without a background colour become transparent cells
+
+#include "art.h"
+#include "colour.h"
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ART_MAX_W 1024
+#define ART_MAX_H 1024
+#define SGR_MAX_PARAMS 16
+
+// colour.c reads the output mode from the config
+struct config config;
+struct lang lang;
+
+struct canvas {
+	struct tb_cell *cells;
+	uint16_t width;
+	uint16_t height;
+	uint16_t wrap;
+
+	int x;
+	int y;
+	uintattr_t fg;
+	uintattr_t bg;
+	uintattr_t attr;
+};
+
+static void put(struct canvas *canvas, uint32_t ch) {
+	if(canvas->wrap != 0 && canvas->x >= canvas->wrap) {
+		canvas->x = 0;
+		++canvas->y;
+	}
+
+	if(canvas->x < 0 || canvas->y < 0 || canvas->x >= ART_MAX_W ||
+	   canvas->y >= ART_MAX_H) {
+		++canvas->x;
+		return;
+	}
+
+	uintattr_t fg = canvas->fg | canvas->attr;
+	uintattr_t bg = canvas->bg;
+
+	// the animation shows through blank cells without a background
+	if(ch != ' ' || bg != TB_DEFAULT || (canvas->attr & TB_REVERSE)) {
+		canvas->cells[canvas->y * ART_MAX_W + canvas->x] =
+			(struct tb_cell){ch, fg, bg};
+	}
+
+	++canvas->x;
+
+	if(canvas->x > canvas->width) {
+		canvas->width = canvas->x;
+	}
+
+	if(canvas->y + 1 > canvas->height) {
+		canvas->height = canvas->y + 1;
+	}
+}
+
+static void sgr(struct canvas *canvas, const int *params, int len) {
+	if(len == 0) {
+		params = (const int[]){0};
+		len = 1;
+	}
+
+	for(int i = 0; i < len; ++i) {
+		int p = params[i];
+
+		if((p == 38 || p == 48) && i + 2 < len && params[i + 1] == 5) {
+			uintattr_t colour = colour_index(params[i + 2]);
+			*(p == 38 ? &canvas->fg : &canvas->bg) = colour;
+			i += 2;
+		} else if((p == 38 || p == 48) && i + 4 < len && params[i + 1] == 2) {
+			uintattr_t colour =
+				colour_rgb(params[i + 2], params[i + 3], params[i + 4]);
+			*(p == 38 ? &canvas->fg : &canvas->bg) = colour;
+			i += 4;
+		} else if(p == 0) {
+			canvas->fg = TB_DEFAULT;
+			canvas->bg = TB_DEFAULT;
+			canvas->attr = 0;
+		} else if(p == 1) {
+			canvas->attr |= TB_BOLD;
+		} else if(p == 4) {
+			canvas->attr |= TB_UNDERLINE;
+		} else if(p == 7) {
+			canvas->attr |= TB_REVERSE;
+		} else if(p == 22) {
+			canvas->attr &= ~TB_BOLD;
+		} else if(p == 24) {
+			canvas->attr &= ~TB_UNDERLINE;
+		} else if(p == 27) {
+			canvas->attr &= ~TB_REVERSE;
+		} else if(p >= 30 && p <= 37) {
+			canvas->fg = colour_index(p - 30);
+		} else if(p == 39) {
+			canvas->fg = TB_DEFAULT;
+		} else if(p >= 40 && p <= 47) {
+			canvas->bg = colour_index(p - 40);
+		} else if(p == 49) {
+			canvas->bg = TB_DEFAULT;
+		} else if(p >= 90 && p <= 97) {
+			canvas->fg = colour_index(p - 90 + 8);
+		} else if(p >= 100 && p <= 107) {
+			canvas->bg = colour_index(p - 100 + 8);
+		}
+	}
+}
+
+// handles the sequence after `ESC [`, returns the bytes it used
+static size_t csi(struct canvas *canvas, const char *s, size_t len) {
+	int params[SGR_MAX_PARAMS];
+	int count = 0;
+	int value = 0;
+	bool digits = false;
+	size_t i = 0;
+
+	for(; i < len; ++i) {
+		char c = s[i];
+
+		if(c >= '0' && c <= '9') {
+			value = value * 10 + (c - '0');
+			digits = true;
+		} else if(c == ';') {
+			if(count < SGR_MAX_PARAMS) {
+				params[count++] = value;
+			}
+
+			value = 0;
+			digits = false;
+		} else if(c >= 0x40 && c <= 0x7e) {
+			break;
+		}
+	}
+
+	if(i == len) {
+		return len;
+	}
+
+	if((digits || count > 0) && count < SGR_MAX_PARAMS) {
+		params[count++] = value;
+	}
+
+	int n = (count > 0 && params[0] > 0) ? params[0] : 1;
+
+	switch(s[i]) {
+		case 'm':
+			sgr(canvas, params, count);
+			break;
+		case 'A':
+			canvas->y -= n;
+			break;
+		case 'B':
+			canvas->y += n;
+			break;
+		case 'C':
+			canvas->x += n;
+			break;
+		case 'D':
+			canvas->x -= n;
+			break;
+		case 'H':
+		case 'f':
+			canvas->y = n - 1;
+			canvas->x = (count > 1 && params[1] > 0) ? params[1] - 1 : 0;
+			break;
+		default:
+			break;
+	}
+
+	if(canvas->x < 0) {
+		canvas->x = 0;
+	}
+
+	if(canvas->y < 0) {
+		canvas->y = 0;
+	}
+
+	return i + 1;
+}
+
+// returns the bytes of the UTF-8 sequence, invalid bytes are taken alone
+static size_t utf8_decode(const unsigned char *s, size_t len, uint32_t *ch) {
+	size_t n = s[0] < 0x80   ? 1
+	           : s[0] < 0xe0 ? 2
+	           : s[0] < 0xf0 ? 3
+	                         : 4;
+
+	if(s[0] < 0xc0 && s[0] >= 0x80) {
+		n = 1;
+	}
+
+	if(n > len) {
+		*ch = '?';
+		return 1;
+	}
+
+	if(n == 1) {
+		*ch = s[0] < 0x80 ? s[0] : '?';
+		return 1;
+	}
+
+	uint32_t value = s[0] & (0xff >> (n + 1));
+
+	for(size_t i = 1; i < n; ++i) {
+		if((s[i] & 0xc0) != 0x80) {
+			*ch = '?';
+			return 1;
+		}
+
+		value = (value << 6) | (s[i] & 0x3f);
+	}
+
+	*ch = value;
+	return n;
+}
+
+static void convert(struct canvas *canvas, const char *data, size_t len) {
+	size_t i = 0;
+
+	while(i < len) {
+		unsigned char c = data[i];
+
+		// a SAUCE record may follow the end of file marker
+		if(c == 0x1a) {
+			break;
+		}
+
+		if(c == 0x1b && i + 1 < len && data[i + 1] == '[') {
+			i += 2 + csi(canvas, data + i + 2, len - i - 2);
+			continue;
+		}
+
+		if(c == '\n') {
+			canvas->x = 0;
+			++canvas->y;
+		} else if(c == '\r') {
+			canvas->x = 0;
+		} else if(c == '\t') {
+			canvas->x = (canvas->x / 8 + 1) * 8;
+		} else if(c >= 0x20) {
+			uint32_t ch;
+			i += utf8_decode((const unsigned char *)data + i, len - i, &ch);
+			put(canvas, ch);
+			continue;
+		}
+
+		++i;
+	}
+}
+
+static char *read_all(const char *path, size_t *len) {
+	FILE *file = fopen(path, "rb");
+
+	if(file == NULL) {
+		return NULL;
+	}
+
+	size_t cap = 4096;
+	char *data = malloc(cap);
+	*len = 0;
+
+	while(data != NULL) {
+		*len += fread(data + *len, 1, cap - *len, file);
+
+		if(*len < cap) {
+			break;
+		}
+
+		cap *= 2;
+		char *grown = realloc(data, cap);
+
+		if(grown == NULL) {
+			free(data);
+		}
+
+		data = grown;
+	}
+
+	fclose(file);
+	return data;
+}
+
+static bool write_art(const char *path, const struct canvas *canvas) {
+	FILE *file = fopen(path, "wb");
+
+	if(file == NULL) {
+		return false;
+	}
+
+	struct art_header header = {0};
+	memcpy(header.magic, ART_MAGIC, sizeof(header.magic));
+	header.mode = colour_mode();
+	header.width = canvas->width;
+	header.height = canvas->height;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	for(int y = 0; ok && y < canvas->height; ++y) {
+		for(int x = 0; ok && x < canvas->width; ++x) {
+			const struct tb_cell *cell = &canvas->cells[y * ART_MAX_W + x];
+			uint32_t raw[3] = {cell->ch, cell->fg, cell->bg};
+			ok = fwrite(raw, sizeof(raw), 1, file) == 1;
+		}
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: lye-art [-m normal|256|truecolor] [-w width] "
+	                "input output\n");
+}
+
+int main(int argc, char **argv) {
+	struct canvas canvas = {0};
+	const char *paths[2];
+	int path_count = 0;
+
+	for(int i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			config.output_mode = argv[++i];
+		} else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			canvas.wrap = atoi(argv[++i]);
+		} else if(argv[i][0] != '-' && path_count < 2) {
+			paths[path_count++] = argv[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if(path_count != 2) {
+		usage();
+		return 1;
+	}
+
+	colour_init();
+
+	if(config.output_mode != NULL &&
+	   strcmp(config.output_mode, colour_mode_name()) != 0) {
+		fprintf(stderr, "lye-art: output mode %s is not supported\n",
+		        config.output_mode);
+		return 1;
+	}
+
+	size_t len;
+	char *data = read_all(paths[0], &len);
+
+	if(data == NULL) {
+		fprintf(stderr, "lye-art: could not read %s\n", paths[0]);
+		return 1;
+	}
+
+	canvas.cells = calloc((size_t)ART_MAX_W * ART_MAX_H, sizeof(*canvas.cells));
+
+	if(canvas.cells == NULL) {
+		fprintf(stderr, "lye-art: out of memory\n");
+		free(data);
+		return 1;
+	}
+
+	convert(&canvas, data, len);
+	free(data);
+
+	bool ok = write_art(paths[1], &canvas);
+	free(canvas.cells);
+
+	if(!ok) {
+		fprintf(stderr, "lye-art: could not write %s\n", paths[1]);
+		return 1;
+	}
+
+	printf("%ux%u cells, %s colours\n", canvas.width, canvas.height,
+	       colour_mode_name());
+
+	return 0;
+}
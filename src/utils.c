@@ -6,12 +6,14 @@
 #include "inputs.h"
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
 #if defined(__DragonFly__) || defined(__FreeBSD__)
@@ -40,21 +42,6 @@ void *realloc_or_throw(void *old, size_t size) {
 	return new;
 }
 
-void draw_cells(uint16_t x, uint16_t y, uint16_t w, uint16_t h, struct tb_cell *cells) { // Jank
-	const size_t buf_width = tb_width();
-
-	struct tb_cell *buf = tb_cell_buffer();
-
-	struct tb_cell *src = cells;
-	struct tb_cell *dst = buf + y * buf_width + x;
-
-	for(size_t i = 0; i < h; i++) {
-		memcpy(dst, src, w * sizeof(*cells));
-		dst += buf_width;
-		src += w;
-	}
-}
-
 void desktop_crawl(struct desktop *target, char *sessions,
                    enum display_server server) {
 	DIR *dir;
@@ -193,20 +180,42 @@ void hostname(char **out) {
 
 void free_hostname() { free(hostname_backup); }
 
+uint64_t monotonic_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int console_fd = -1;
+
+// the console stays open for the lifetime of lye, it is closed on exec so
+// that sessions do not inherit it
+int console_open() {
+	if(console_fd < 0) {
+		console_fd = open(config.console_dev, O_RDONLY | O_CLOEXEC);
+	}
+
+	return console_fd;
+}
+
+void console_close() {
+	if(console_fd >= 0) {
+		close(console_fd);
+		console_fd = -1;
+	}
+}
+
 void switch_tty(struct term_buf *buf) {
-	FILE *console = fopen(config.console_dev, "w");
+	int fd = console_open();
 
-	if(console == NULL) {
+	if(fd < 0) {
 		buf->info_line = lang.err_console_dev;
 		return;
 	}
 
-	int fd = fileno(console);
-
 	ioctl(fd, VT_ACTIVATE, config.tty);
 	ioctl(fd, VT_WAITACTIVE, config.tty);
-
-	fclose(console);
 }
 
 void save(struct desktop *desktop, struct text *login) {
@@ -5,6 +5,7 @@
 #define UNUSED(obj) ((void)(obj))
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "config.h"
 #include "draw.h"
@@ -12,10 +13,12 @@
 
 void *malloc_or_throw(size_t size);
 void *realloc_or_throw(void *old, size_t size);
-void draw_cells(uint16_t x, uint16_t y, uint16_t w, uint16_t h, struct tb_cell *cells); // Jank
 void desktop_load(struct desktop *target);
 void hostname(char **out);
 void free_hostname();
+uint64_t monotonic_ms();
+int console_open();
+void console_close();
 void switch_tty(struct term_buf *buf);
 void save(struct desktop *desktop, struct text *login);
 void load(struct desktop *desktop, struct text *login);